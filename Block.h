@@ -4,6 +4,7 @@
 
 #include <SGL/Math/Vector2.h>
 #include <SGL/Math/Vector3.h>
+#include <SGL/Math/Vector4.h>
 #include <SGL/Graphics/Color.h>
 
 #include <cstdint>
@@ -11,16 +12,25 @@
 #define R_MASK 0x000F    // mask for light R channel
 #define G_MASK 0x00F0    // mask for light G channel
 #define B_MASK 0x0F00    // mask for light B channel
+#define S_MASK 0xF000    // mask for sky light channel
 
 #define CHNL_MASK 0x000F // mask for a single channel of light
 #define CHNL_BITS 4      // bits per channel
 
+#define MAX_LIGHT_LEVEL CHNL_MASK // level of a channel at full sky light and the brightest sources
+
+// blocks from a source its light can reach. A level is lost per block, so the last block lit is
+// MAX_LIGHT_LEVEL - 1 away, and the fill reads one block past it to see whether a face is covered
+#define LIGHT_RANGE MAX_LIGHT_LEVEL
+
 // get the R channel value
 #define GET_LIGHT_LEVEL_R(light) ((light & R_MASK))
 // get the G channel value
 #define GET_LIGHT_LEVEL_G(light) ((light & G_MASK) >> CHNL_BITS )
 // get the B channel value
 #define GET_LIGHT_LEVEL_B(light) ((light & B_MASK) >> (CHNL_BITS * 2) )
+// get the sky channel value
+#define GET_LIGHT_LEVEL_S(light) ((light & S_MASK) >> (CHNL_BITS * 3) )
 
 // set the R channel value
 #define SET_LIGHT_LEVEL_R(light, level) (light) = ( ( (light) & ~R_MASK ) | ((level) & CHNL_MASK) )
@@ -28,14 +38,26 @@
 #define SET_LIGHT_LEVEL_G(light, level) (light) = ( ( (light) & ~G_MASK ) | ((level) & CHNL_MASK) << (CHNL_BITS) )
 // get the B channel value
 #define SET_LIGHT_LEVEL_B(light, level) (light) = ( ( (light) & ~B_MASK ) | ((level) & CHNL_MASK) << (CHNL_BITS * 2) )
+// set the sky channel value
+#define SET_LIGHT_LEVEL_S(light, level) (light) = ( ( (light) & ~S_MASK ) | ((level) & CHNL_MASK) << (CHNL_BITS * 3) )
 
 // light data type
 typedef uint16_t light_t;
 
+// how the light of a chunk is stored
+enum class LightModel
+{
+	PER_FACE, // a light value per face of every block, light spreads over the faces of solid blocks
+	PER_VOXEL // a light value per block, faces take the light of the block in front of them
+};
+
 /**
 	A single vertex for mesh creation
 
-	Contains position, normal, texCoord and color attributes
+	Contains position, normal, texCoord, color and texture region attributes.
+
+	texCoord is in tile space, a face spanning N blocks has coordinates from 0 to N so the texture repeats across it.
+	region is the atlas region the tile is mapped into as (u, v, width, height)
 */
 struct Vertex
 {
@@ -55,15 +77,16 @@ struct Vertex
 	sgl::Vector3     normal;
 	sgl::Vector2     texCoord;
 	sgl::ColorRGB32f color;
+	sgl::Vector4     region;
 };
 
 struct Block
 {
-	Block() : Block(0, 0, 0, 0)
+	Block() : Block(0)
 	{
 	}
 
-	Block(uint8_t t, uint8_t x, uint8_t y, uint8_t z) : t(t), x(x), y(y), z(z)
+	Block(uint8_t t) : t(t)
 	{
 		lights[0] = 0;
 		lights[1] = 0;
@@ -74,9 +97,6 @@ struct Block
 	}
 
 	uint8_t  t;        // the block type
-	uint8_t  x;        // block x value in chunk
-	uint8_t  y;        // block y value in chunk
-	uint8_t  z;        // block z value in chunk
 	light_t lights[6]; // light values for each face
 };
 
@@ -88,6 +108,34 @@ enum class BlockFace
 	NEAR, FAR
 };
 
+/**
+	Compact vertex for chunk local geometry, 8 bytes
+
+	data0: x (8 bits) | y (8 bits) | z (8 bits) | face (3 bits) | ambient occlusion (2 bits) | unused (3 bits)
+	data1: light (16 bits) | atlas region index (16 bits)
+
+	(x, y, z) is the block corner relative to the chunk origin. The normal and the tile coordinates are
+	decoded from the face in the shader
+*/
+struct PackedVertex
+{
+	PackedVertex(int x, int y, int z, BlockFace face, int ao, light_t light, int region) :
+		data0((uint32_t)(x & 0xFF) | ((uint32_t)(y & 0xFF) << 8) | ((uint32_t)(z & 0xFF) << 16) | ((uint32_t)face << 24) | ((uint32_t)(ao & 3) << 27)),
+		data1((uint32_t)light | ((uint32_t)(region & 0xFFFF) << 16))
+	{
+	}
+
+	uint32_t data0;
+	uint32_t data1;
+};
+
+// vertex layout used by chunk meshes
+enum class VertexFormat
+{
+	FLOAT, // Vertex
+	PACKED // PackedVertex
+};
+
 // check if a block is opaque
 static bool isBlockOpaque(Block& block)
 {
@@ -0,0 +1,161 @@
+
+#include "BlockStorage.h"
+
+#include <cassert>
+
+using namespace engine;
+
+BlockStorage::BlockStorage(int count) :
+	_count(count),
+	_bits(0)
+{
+	fill(0);
+}
+
+uint8_t BlockStorage::get(int idx) const
+{
+	assert(idx >= 0 && idx < _count);
+
+	// uniform fast path
+	if (_bits == 0) return _palette[0];
+
+	return _palette[getIndex(idx)];
+}
+
+void BlockStorage::set(int idx, uint8_t type)
+{
+	assert(idx >= 0 && idx < _count);
+
+	if (_bits == 0)
+	{
+		if (_palette[0] == type) return;
+
+		// the block will differ from the rest
+		resize(1);
+	}
+
+	unsigned int current = getIndex(idx);
+
+	if (_palette[current] == type) return;
+
+	// release the current entry first so its slot can be reused
+	_refCounts[current]--;
+
+	unsigned int paletteIdx = addToPalette(type);
+
+	setIndex(idx, paletteIdx);
+	_refCounts[paletteIdx]++;
+
+	// collapse back to a single value when every block has the same type
+	if (_refCounts[paletteIdx] == (uint32_t)_count)
+		fill(type);
+}
+
+void BlockStorage::fill(uint8_t type)
+{
+	_bits = 0;
+
+	_palette.assign(1, type);
+	_refCounts.assign(1, (uint32_t)_count);
+
+	_words.clear();
+	_words.shrink_to_fit();
+}
+
+bool BlockStorage::isUniform() const
+{
+	return _bits == 0;
+}
+
+int BlockStorage::getBitsPerBlock() const
+{
+	return _bits;
+}
+
+unsigned int BlockStorage::getMemoryUsage() const
+{
+	return (unsigned int)(sizeof(BlockStorage) +
+		_palette.capacity()   * sizeof(uint8_t)  +
+		_refCounts.capacity() * sizeof(uint32_t) +
+		_words.capacity()     * sizeof(uint64_t));
+}
+
+unsigned int BlockStorage::getIndex(int idx) const
+{
+	// _bits is a power of two so indices never straddle words
+	int perWord = 64 / _bits;
+	int shift   = (idx % perWord) * _bits;
+
+	uint64_t mask = (1ull << _bits) - 1;
+
+	return (unsigned int)((_words[idx / perWord] >> shift) & mask);
+}
+
+void BlockStorage::setIndex(int idx, unsigned int paletteIdx)
+{
+	int perWord = 64 / _bits;
+	int shift   = (idx % perWord) * _bits;
+
+	uint64_t mask = ((1ull << _bits) - 1) << shift;
+
+	uint64_t& word = _words[idx / perWord];
+	word = (word & ~mask) | (((uint64_t)paletteIdx << shift) & mask);
+}
+
+unsigned int BlockStorage::addToPalette(uint8_t type)
+{
+	unsigned int freeSlot = (unsigned int)_palette.size();
+
+	unsigned int i;
+	for (i = 0; i < _palette.size(); ++i)
+	{
+		if (_refCounts[i] == 0)
+		{
+			if (freeSlot == _palette.size()) freeSlot = i;
+		}
+		else if (_palette[i] == type)
+		{
+			return i;
+		}
+	}
+
+	if (freeSlot < _palette.size())
+	{
+		_palette[freeSlot] = type;
+		return freeSlot;
+	}
+
+	// the palette is full, widen the indices
+	if (_palette.size() >= (1u << _bits))
+		resize(_bits * 2);
+
+	_palette.push_back(type);
+	_refCounts.push_back(0);
+
+	return freeSlot;
+}
+
+void BlockStorage::resize(int bits)
+{
+	assert(bits <= 8);
+
+	int perWord = 64 / bits;
+
+	std::vector<uint64_t> words((_count + perWord - 1) / perWord, 0);
+
+	// the uniform storage has every block referencing entry 0, which the zeroed words already encode
+	if (_bits != 0)
+	{
+		uint64_t mask = (1ull << bits) - 1;
+
+		int i;
+		for (i = 0; i < _count; ++i)
+		{
+			uint64_t paletteIdx = getIndex(i);
+			words[i / perWord] |= (paletteIdx & mask) << ((i % perWord) * bits);
+		}
+	}
+
+	_words.swap(words);
+	_bits = bits;
+}
@@ -0,0 +1,81 @@
+
+#ifndef BLOCKSTORAGE_H
+#define BLOCKSTORAGE_H
+
+#include <vector>
+#include <cstdint>
+
+namespace engine
+{
+	/**
+		Palette compressed storage of block types.
+
+		Each distinct type in use is stored once in a palette and every block stores a bit packed index into it,
+		using 1, 2, 4 or 8 bits depending on the palette size. When all blocks share one type only that value is
+		stored
+	*/
+	class BlockStorage
+	{
+	public:
+
+		/**
+			Create storage for count blocks, all of type 0
+		*/
+		BlockStorage(int count);
+
+		/**
+			@return the type of block idx
+		*/
+		uint8_t get(int idx) const;
+
+		/**
+			Set the type of block idx
+		*/
+		void set(int idx, uint8_t type);
+
+		/**
+			Set every block to type
+		*/
+		void fill(uint8_t type);
+
+		/**
+			@return true if every block has the same type
+		*/
+		bool isUniform() const;
+
+		/**
+			@return the number of bits used per block
+		*/
+		int getBitsPerBlock() const;
+
+		/**
+			@return the number of bytes used by the storage
+		*/
+		unsigned int getMemoryUsage() const;
+
+	private:
+
+		// number of blocks
+		int _count;
+		// bits per palette index, 0 when the storage is uniform
+		int _bits;
+
+		// the distinct block types
+		std::vector<uint8_t>  _palette;
+		// number of blocks referencing each palette entry, entries with no references are reused
+		std::vector<uint32_t> _refCounts;
+		// bit packed palette indices
+		std::vector<uint64_t> _words;
+
+	private:
+
+		unsigned int getIndex(int idx) const;
+		void setIndex(int idx, unsigned int paletteIdx);
+
+		unsigned int addToPalette(uint8_t type);
+
+		void resize(int bits);
+	};
+}
+
+#endif
@@ -1,251 +1,1170 @@
 
 #include "Chunk.h"
 
-#include "VoxelEngine.h"
+#include "ChunkManager.h"
+#include "FatalError.h"
 
 #include <SGL/Math/Vector4.h>
 
 #include <iostream>
 #include <memory>
+#include <algorithm>
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 using namespace engine;
 using namespace sgl;
 
+// index of the lowest set bit, bits must not be 0
+static inline int lowestBit(uint64_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanForward64(&idx, bits);
+	return (int)idx;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+// index of the highest set bit, bits must not be 0
+static inline int highestBit(uint64_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanReverse64(&idx, bits);
+	return (int)idx;
+#else
+	return 63 - __builtin_clzll(bits);
+#endif
+}
+
+// the axis a face points along (d), the two axes spanning it (u, v) and the direction it faces, indexed by BlockFace.
+// u and v are chosen so quad corners wind the same way as the faces made by createCubeMesh
+static const struct
+{
+	int d, u, v;
+	int dir;
+}
+FACE_AXES[] = {
+	{ 0, 1, 2, -1 }, // left
+	{ 0, 1, 2,  1 }, // right
+	{ 1, 2, 0,  1 }, // top
+	{ 1, 2, 0, -1 }, // bottom
+	{ 2, 0, 1, -1 }, // near
+	{ 2, 0, 1,  1 }  // far
+};
+
+// bit of the pair of chunk sides a and b in the side connection mask, 15 pairs of different sides
+static inline int getSidePairBit(int a, int b)
+{
+	if (a > b) std::swap(a, b);
+
+	return a * (11 - a) / 2 + (b - a - 1);
+}
+
+// steps along u and v from the center of a face to its corners, in the order quads are wound
+static const int QUAD_CORNERS[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+
+// ambient occlusion level of quad corner i
+static inline int getCornerOcclusion(uint8_t ao, int i)
+{
+	return (ao >> (i * 2)) & 3;
+}
+
+// light of quad corner i, 16 bits per corner
+static inline light_t getCornerLight(uint64_t lights, int i)
+{
+	return (light_t)(lights >> (i * 16));
+}
+
+// the four channels of a light, one in each byte, so up to 16 lights can be summed without carrying across channels
+static inline uint32_t spreadLight(light_t light)
+{
+	return (light & 0x0F0F) | ((uint32_t)(light & 0xF0F0) << 12);
+}
+
+// a light back from the bytes of spreadLight, the bytes must be 4 bits
+static inline light_t packLight(uint32_t spread)
+{
+	return (light_t)((spread & 0x0F0F) | ((spread >> 12) & 0xF0F0));
+}
+
+/**
+	Shading of face corners for every set of solid cells around the cell in front of the face. The front cell and
+	the 8 cells around it in the plane of the face are numbered (du + 1) + (dv + 1) * 3 for the steps du and dv
+	along the face's u and v axes, a set of solid cells has bit n set for cell n
+*/
+static const struct ShadingCells
+{
+	// ambient occlusion level of the four quad corners, 2 bits per corner
+	uint8_t occlusion[512];
+
+	// the four cells a corner's light is averaged over. The front cell stands in for solid cells, and for the
+	// diagonal cell when both sides are solid as light doesn't reach past them
+	uint8_t corners[512][4][4];
+
+	ShadingCells()
+	{
+		int solid, i;
+		for (solid = 0; solid < 512; ++solid)
+		{
+			occlusion[solid] = 0;
+
+			for (i = 0; i < 4; ++i)
+			{
+				int side1    = (QUAD_CORNERS[i][0] + 1) + 3;
+				int side2    = 1 + (QUAD_CORNERS[i][1] + 1) * 3;
+				int diagonal = (QUAD_CORNERS[i][0] + 1) + (QUAD_CORNERS[i][1] + 1) * 3;
+
+				int s1 = (solid >> side1) & 1;
+				int s2 = (solid >> side2) & 1;
+				int c  = (solid >> diagonal) & 1;
+
+				// two sides close the corner off whatever the diagonal block is
+				int level = (s1 && s2) ? 0 : 3 - (s1 + s2 + c);
+
+				occlusion[solid] |= (uint8_t)(level << (i * 2));
+
+				corners[solid][i][0] = 4;
+				corners[solid][i][1] = s1 ? 4 : side1;
+				corners[solid][i][2] = s2 ? 4 : side2;
+				corners[solid][i][3] = (c || (s1 && s2)) ? 4 : diagonal;
+			}
+		}
+	}
+}
+SHADING_CELLS;
+
+// split quads along the corner 1 to 3 diagonal when it is the darker one, so the occlusion is interpolated the
+// same way whichever way the face is oriented
+static inline bool shouldFlipQuad(uint8_t ao)
+{
+	return getCornerOcclusion(ao, 0) + getCornerOcclusion(ao, 2) < getCornerOcclusion(ao, 1) + getCornerOcclusion(ao, 3);
+}
+
 Chunk::Chunk(int size) : Chunk(size, 1)
 {
 }
 
 Chunk::Chunk(int size, float blockSize) : 
-	_mesh(Mesh::Type::TRIANGLES, Buffer::Usage::STATIC_DRAW),
-	_size(size),
-	_blockSize(blockSize),
-	_dirty(true),
-	_shouldRender(false),
-	_hasLocation(false),
-
 	left(nullptr),
 	right(nullptr),
 	top(nullptr),
 	bottom(nullptr),
 	near(nullptr),
-	far(nullptr)
+	far(nullptr),
+
+	_mesh(VertexFormat::FLOAT),
+	_rebuildAll(true),
+	_hasGeometry(true),
+	_solidSides(0),
+	_sideConnections(0x7FFF),
+	_connectionsStale(true),
+	_caveCulling(false),
+	_blocks(size * size * size),
+	_tileRegions(nullptr),
+	_meshMode(MeshMode::CUBE),
+	_lightModel(LightModel::PER_FACE),
+	_vertexFormat(VertexFormat::FLOAT),
+	_size(size),
+	_blockSize(blockSize),
+	_dirty(true),
+	_lightChanged(false),
+	_visible(false),
+	_shouldRender(false),
+	_hasLocation(false)
 {
-	// allocate blocks and flags
-	_blocks.resize(size * size * size);
-	_hasLocationFlags.resize(size * size * size, false);
+	// wider chunks would silently drop the blocks past the end of the culling masks, in release builds too
+	if (size < 1 || size > MAX_SIZE)
+		fatalError("Error: a chunk must be 1 to " + std::to_string(MAX_SIZE) + " blocks wide, not " + std::to_string(size));
 
-	// setup mesh
-	_mesh.addAttribute(VertexAttribute(0, 3));
-	_mesh.addAttribute(VertexAttribute(1, 3));
-	_mesh.addAttribute(VertexAttribute(2, 2));
-	_mesh.addAttribute(VertexAttribute(3, 3));
+	int i;
+	for (i = 0; i < 3; ++i)
+	{
+		_geometryMin[i] = 0;
+		_geometryMax[i] = size;
+	}
 
-	_mesh.create(sizeof(Vertex));
+	markAllDirty();
 }
 
 void Chunk::setBlock(int x, int y, int z, int t)
 {
-	Block* block = getBlock(x, y, z);
-	block->t = t;
+	int idx = getIndex(x, y, z);
 
-	_dirty = true;
+	if (_blocks.get(idx) == (uint8_t)t) return;
+
+	_blocks.set(idx, (uint8_t)t);
+
+	// the light around the block may spread differently now. Chunks that are unlit and were never meshed are
+	// still being generated and get their light from the sources when they are first built
+	if (!_lights.empty() || !_sectionOffsets.empty())
+		_pendingLights.push_back(idx);
+
+	markBlockDirty(x, y, z);
+
+	// neighbors only need remeshing when the block is on their border, including the edge and corner
+	// neighbors whose ambient occlusion samples it
+	bool border = (x == 0 || x == _size - 1) || (y == 0 || y == _size - 1) || (z == 0 || z == _size - 1);
+
+	if (!border) return;
+
+	int dx, dy, dz;
+	for (dx = -1; dx <= 1; ++dx)
+	{
+		for (dy = -1; dy <= 1; ++dy)
+		{
+			for (dz = -1; dz <= 1; ++dz)
+			{
+				int ax = x + dx;
+				int ay = y + dy;
+				int az = z + dz;
+
+				bool inside = (ax >= 0 && ax < _size) && (ay >= 0 && ay < _size) && (az >= 0 && az < _size);
+				if (inside) continue;
+
+				Chunk* chunk = getAdjacentChunk(ax, ay, az);
+
+				if (chunk != nullptr)
+					chunk->markBlockDirty(ax, ay, az);
+			}
+		}
+	}
 }
 
-Block* Chunk::getBlock(int x, int y, int z)
+Block Chunk::getBlock(int x, int y, int z)
 {
-	int idx = (x * _size) + (y * _size * _size) + z;
+	return getBlock(getIndex(x, y, z));
+}
 
-	Block* block = &_blocks[idx];
+Block Chunk::getBlock(int idx) const
+{
+	Block block(_blocks.get(idx));
 
-	if (!_hasLocationFlags[idx])
+	if (!_lights.empty())
 	{
-		block->x = x;
-		block->y = y;
-		block->z = z;
+		int i;
+		for (i = 0; i < 6; ++i)
+			block.lights[i] = getLight(idx, static_cast<BlockFace>(i));
 	}
 
 	return block;
 }
 
-Block* Chunk::getAdjacentBlock(int x, int y, int z)
+Block Chunk::getAdjacentBlock(int x, int y, int z)
 {
-	if (x < 0)
+	Chunk* chunk = getAdjacentChunk(x, y, z);
+
+	// blocks outside of the grid are treated as air
+	if (chunk == nullptr) return Block();
+
+	return chunk->getBlock(x, y, z);
+}
+
+uint8_t Chunk::getAdjacentBlockType(int x, int y, int z)
+{
+	Chunk* chunk = getAdjacentChunk(x, y, z);
+
+	if (chunk == nullptr) return 0;
+
+	return chunk->getBlockType(chunk->getIndex(x, y, z));
+}
+
+light_t Chunk::getAdjacentLight(int x, int y, int z)
+{
+	Chunk* chunk = getAdjacentChunk(x, y, z);
+
+	if (chunk == nullptr) return 0;
+
+	// any face, per voxel light is the same for all of them
+	return chunk->getLight(chunk->getIndex(x, y, z), BlockFace::LEFT);
+}
+
+Chunk* Chunk::getAdjacentChunk(int& x, int& y, int& z)
+{
+	Chunk* chunk = this;
+
+	// walk the neighbors until the coordinates are inside of a chunk
+	while (chunk != nullptr)
 	{
-		if (this->left != nullptr)
-			return this->left->getAdjacentBlock(_size + x, y, z);
+		if (x < 0)
+		{
+			chunk = chunk->left;
+			x += _size;
+		}
+		else if (x >= _size)
+		{
+			chunk = chunk->right;
+			x -= _size;
+		}
+		else if (y < 0)
+		{
+			chunk = chunk->bottom;
+			y += _size;
+		}
+		else if (y >= _size)
+		{
+			chunk = chunk->top;
+			y -= _size;
+		}
+		else if (z < 0)
+		{
+			chunk = chunk->near;
+			z += _size;
+		}
+		else if (z >= _size)
+		{
+			chunk = chunk->far;
+			z -= _size;
+		}
 		else
-			return nullptr;
+		{
+			break;
+		}
 	}
-	else if (x >= _size)
+
+	return chunk;
+}
+
+int Chunk::getIndex(int x, int y, int z) const
+{
+	return (x * _size) + (y * _size * _size) + z;
+}
+
+uint8_t Chunk::getBlockType(int idx) const
+{
+	return _blocks.get(idx);
+}
+
+light_t Chunk::getLight(int idx, BlockFace face) const
+{
+	if (_lights.empty()) return 0;
+
+	if (_lightModel == LightModel::PER_VOXEL) return _lights[idx];
+
+	return _lights[idx * 6 + static_cast<int>(face)];
+}
+
+void Chunk::setLight(int idx, BlockFace face, light_t light)
+{
+	if (_lights.empty())
 	{
-		if (this->right != nullptr)
-			return this->right->getAdjacentBlock(x - _size, y, z);
-		else
-			return nullptr;
+		// unlit chunks don't store any light
+		if (light == 0) return;
+
+		_lights.resize(_size * _size * _size * getLightSlots(), 0);
 	}
 
-	if (y < 0)
+	if (_lightModel == LightModel::PER_VOXEL)
+		_lights[idx] = light;
+	else
+		_lights[idx * 6 + static_cast<int>(face)] = light;
+}
+
+void Chunk::setLightModel(LightModel model)
+{
+	// the stored light doesn't carry over, the chunk has to be lit again
+	_lightModel = model;
+
+	_lights.clear();
+	_lights.shrink_to_fit();
+	_lightSnapshot.clear();
+
+	_rebuildAll = true;
+}
+
+LightModel Chunk::getLightModel(void) const
+{
+	return _lightModel;
+}
+
+int Chunk::getLightSlots(void) const
+{
+	return (_lightModel == LightModel::PER_VOXEL) ? 1 : 6;
+}
+
+void Chunk::setLightSource(int x, int y, int z, int r, int g, int b)
+{
+	light_t light = 0;
+
+	SET_LIGHT_LEVEL_R(light, r);
+	SET_LIGHT_LEVEL_G(light, g);
+	SET_LIGHT_LEVEL_B(light, b);
+
+	int idx = getIndex(x, y, z);
+
+	setLightSource(idx, light);
+	_pendingLights.push_back(idx);
+}
+
+void Chunk::setLightSource(int idx, light_t light)
+{
+	// the light engine writes the light when it seeds the source, until then the block keeps the light
+	// spreading through it
+	_lightSourceList[idx] = light;
+}
+
+void Chunk::removeLight(int x, int y, int z)
+{
+	_lightRemovalList.push_back(getIndex(x, y, z));
+}
+
+void Chunk::render()
+{
+	// world position of block corner (0, 0, 0)
+	Vector3 origin(
+		_offset.x * (_size * _blockSize * 2) - _blockSize,
+		_offset.y * (_size * _blockSize * 2) - _blockSize,
+		_offset.z * (_size * _blockSize * 2) - _blockSize
+	);
+
+	_mesh.draw(origin);
+}
+
+void Chunk::takeSnapshot()
+{
+	int padded = _size + 2;
+
+	// padded range to copy, the dirty region plus the border around it
+	int lo[3], hi[3];
+
+	int i;
+	bool lightMissing = (_lightModel == LightModel::PER_VOXEL) && _lightSnapshot.size() != _snapshot.size();
+
+	if (_rebuildAll || lightMissing || _snapshot.size() != (size_t)(padded * padded * padded))
 	{
-		if (this->bottom != nullptr)
-			return this->bottom->getAdjacentBlock(x, _size + y, z);
-		else
-			return nullptr;
+		_snapshot.assign(padded * padded * padded, 0);
+		_solidRows.assign(padded * padded, 0);
+
+		_connectionsStale = true;
+
+		if (_lightModel == LightModel::PER_VOXEL)
+			_lightSnapshot.assign(padded * padded * padded, 0);
+
+		for (i = 0; i < 3; ++i)
+		{
+			lo[i] = -1;
+			hi[i] = _size;
+		}
 	}
-	else if (y >= _size)
+	else
 	{
-		if (this->top != nullptr)
-			return this->top->getAdjacentBlock(x, y - _size, z);
-		else
-			return nullptr;
+		for (i = 0; i < 3; ++i)
+		{
+			lo[i] = _dirtyMin[i] - 1;
+			hi[i] = _dirtyMax[i] + 1;
+		}
 	}
 
-	if (z < 0)
+	int x, y, z;
+
+	for (y = lo[1]; y <= hi[1]; ++y)
 	{
-		if (this->near != nullptr)
-			return this->near->getAdjacentBlock(x, y, _size + z);
-		else
-			return nullptr;
+		for (x = lo[0]; x <= hi[0]; ++x)
+		{
+			uint8_t* s = &_snapshot[getSnapshotIndex(x, y, 0)];
+
+			for (z = lo[2]; z <= hi[2]; ++z)
+			{
+				bool inside = (x >= 0 && x < _size) && (y >= 0 && y < _size) && (z >= 0 && z < _size);
 
+				// blocks outside of the chunk come from the neighbors, including edges and corners
+				s[z] = inside ? _blocks.get(getIndex(x, y, z)) : getAdjacentBlockType(x, y, z);
+			}
+
+			// faces sample the light in front of them, which may be in a neighbor
+			if (_lightModel == LightModel::PER_VOXEL)
+			{
+				light_t* l = &_lightSnapshot[getSnapshotIndex(x, y, 0)];
+
+				for (z = lo[2]; z <= hi[2]; ++z)
+				{
+					bool inside = (x >= 0 && x < _size) && (y >= 0 && y < _size) && (z >= 0 && z < _size);
+
+					l[z] = inside ? getLight(getIndex(x, y, z), BlockFace::LEFT) : getAdjacentLight(x, y, z);
+				}
+			}
+
+			// one bit per solid block, a word per padded row along z
+			const uint8_t* row = &_snapshot[getSnapshotIndex(x, y, -1)];
+			uint64_t bits = 0;
+
+			for (z = 0; z < padded; ++z)
+				bits |= (uint64_t)(row[z] != 0) << z;
+
+			uint64_t& solid = _solidRows[(x + 1) + (y + 1) * padded];
+
+			// edits that only change a block's type, or the blocks of the neighbors, keep the air of the chunk
+			bool inside = (x >= 0 && x < _size) && (y >= 0 && y < _size);
+
+			if (inside && ((solid ^ bits) & (((1ull << _size) - 1) << 1)) != 0)
+				_connectionsStale = true;
+
+			solid = bits;
+		}
 	}
-	else if (z >= _size)
+}
+
+void Chunk::cullFaces()
+{
+	int padded = _size + 2;
+	int rows   = _size * _size;
+
+	_faceMasks.resize(rows * 6);
+
+	// bits 1 to size of a padded row are inside the chunk
+	uint64_t inside = ((1ull << _size) - 1) << 1;
+
+	int x, y;
+	for (y = _dirtyMin[1]; y <= _dirtyMax[1]; ++y)
 	{
-		if (this->far != nullptr)
-			return this->far->getAdjacentBlock(x, y, z - _size);
-		else
-			return nullptr;
+		for (x = _dirtyMin[0]; x <= _dirtyMax[0]; ++x)
+		{
+			// rows of the block and its four neighbors across x and y, neighbors along z are the adjacent bits
+			const uint64_t* center = &_solidRows[(x + 1) + (y + 1) * padded];
+
+			uint64_t row   = *center;
+			uint64_t solid = row & inside;
+
+			int i = x + y * _size;
+
+			// a face is visible when the block is solid and the neighbor it points at is not
+			_faceMasks[rows * 0 + i] = (solid & ~center[-1])       >> 1; // left
+			_faceMasks[rows * 1 + i] = (solid & ~center[1])        >> 1; // right
+			_faceMasks[rows * 2 + i] = (solid & ~center[padded])   >> 1; // top
+			_faceMasks[rows * 3 + i] = (solid & ~center[-padded])  >> 1; // bottom
+			_faceMasks[rows * 4 + i] = (solid & ~(row << 1))       >> 1; // near
+			_faceMasks[rows * 5 + i] = (solid & ~(row >> 1))       >> 1; // far
+		}
 	}
+}
 
-	return getBlock(x, y, z);
+int Chunk::getSnapshotIndex(int x, int y, int z) const
+{
+	int padded = _size + 2;
+
+	return ((x + 1) * padded) + ((y + 1) * padded * padded) + (z + 1);
 }
 
-void Chunk::setLightSource(int x, int y, int z, int r, int g, int b)
+bool Chunk::isSnapshotSolid(int x, int y, int z) const
 {
-	Block* block = getBlock(x, y, z);
+	int padded = _size + 2;
+
+	return ((_solidRows[(x + 1) + (y + 1) * padded] >> (z + 1)) & 1) != 0;
+}
+
+uint8_t Chunk::getFaceShading(Block& block, int x, int y, int z, BlockFace face, uint64_t& lights) const
+{
+	auto& f = FACE_AXES[static_cast<int>(face)];
+
+	// the cell in front of the face, the face corners are darkened by the blocks around it and lit by the air
+	int front[3] = { x, y, z };
+	front[f.d] += f.dir;
+
+	int padded = _size + 2;
+
+	// snapshot index steps along x, y and z
+	int steps[3] = { padded, padded * padded, 1 };
 
-	setLightLevel(block, r, g, b, BlockFace::LEFT);
-	setLightLevel(block, r, g, b, BlockFace::RIGHT);
-	setLightLevel(block, r, g, b, BlockFace::TOP);
-	setLightLevel(block, r, g, b, BlockFace::BOTTOM);
-	setLightLevel(block, r, g, b, BlockFace::NEAR);
-	setLightLevel(block, r, g, b, BlockFace::FAR);
+	int su = steps[f.u];
+	int sv = steps[f.v];
 
+	// the front cell and the 8 cells around it in the plane of the face, in the order of SHADING_CELLS
+	int cells[9] = { -su - sv, -sv, su - sv, -su, 0, su, -su + sv, sv, su + sv };
+
+	int center = getSnapshotIndex(front[0], front[1], front[2]);
+
+	const uint8_t* types = &_snapshot[center];
+
+	int solid =
+		((types[cells[0]] != 0) << 0) | ((types[cells[1]] != 0) << 1) | ((types[cells[2]] != 0) << 2) |
+		((types[cells[3]] != 0) << 3) |                                   ((types[cells[5]] != 0) << 5) |
+		((types[cells[6]] != 0) << 6) | ((types[cells[7]] != 0) << 7) | ((types[cells[8]] != 0) << 8);
+
+	uint8_t ao = SHADING_CELLS.occlusion[solid];
+
+	// per face light is only known on the faces themselves, so the face is lit evenly
+	if (_lightModel != LightModel::PER_VOXEL)
+	{
+		lights = block.lights[static_cast<int>(face)] * 0x0001000100010001ull;
+		return ao;
+	}
+
+	const light_t* cellLights = &_lightSnapshot[center];
+
+	uint32_t spread[9];
+
+	int i;
+	for (i = 0; i < 9; ++i)
+		spread[i] = spreadLight(cellLights[cells[i]]);
+
+	uint64_t cornerLights = 0;
+
+	for (i = 0; i < 4; ++i)
+	{
+		const uint8_t* corner = SHADING_CELLS.corners[solid][i];
 
-	_lightSourceList[block] = LightNode(block, this);
+		// average of the four cells around the corner, a channel per byte
+		uint32_t sum = spread[corner[0]] + spread[corner[1]] + spread[corner[2]] + spread[corner[3]];
+
+		cornerLights |= (uint64_t)packLight(((sum + 0x02020202) >> 2) & 0x0F0F0F0F) << (i * 16);
+	}
+
+	lights = cornerLights;
+
+	return ao;
 }
 
-void Chunk::removeLight(int x, int y, int z)
+void Chunk::generateMesh()
 {
-	Block* block = getBlock(x, y, z);
+	// the mesh is made of sections, y slices for the cube mesher and one slice per face and depth for the
+	// greedy mesher. Sections outside of the dirty region are copied over from the previous mesh
+	int sectionCount = (_meshMode == MeshMode::GREEDY) ? 6 * _size : _size;
 
-	_lightRemovalList[block] = LightNode(block, this);
+	if (_rebuildAll || _sectionOffsets.size() != (size_t)(sectionCount + 1))
+	{
+		_rebuildAll = true;
+		markAllDirty();
+	}
 
-	_updateCallback(this);
-	_dirty = true;
+	cullFaces();
+
+	std::vector<Vertex>       oldBuffer;
+	std::vector<PackedVertex> oldPackedBuffer;
+	std::vector<unsigned int> oldOffsets;
+
+	oldBuffer.swap(_buffer);
+	oldPackedBuffer.swap(_packedBuffer);
+	oldOffsets.swap(_sectionOffsets);
+
+	_buffer.reserve(oldBuffer.size());
+	_packedBuffer.reserve(oldPackedBuffer.size());
+	_sectionOffsets.reserve(sectionCount + 1);
+
+	// scratch for the greedy mesher
+	std::vector<uint32_t> mask;
+	std::vector<uint64_t> lights;
+	std::vector<Block>    blocks;
+
+	if (_meshMode == MeshMode::GREEDY)
+	{
+		mask.resize(_size * _size);
+		lights.resize(_size * _size);
+		blocks.resize(_size * _size);
+	}
+
+	bool packed = (_vertexFormat == VertexFormat::PACKED);
+
+	int section;
+	for (section = 0; section < sectionCount; ++section)
+	{
+		_sectionOffsets.push_back(packed ? _packedBuffer.size() : _buffer.size());
+
+		// depth of the section along the axis it slices
+		int faceIdx = section / _size;
+		int slice   = section % _size;
+		int axis    = (_meshMode == MeshMode::GREEDY) ? FACE_AXES[faceIdx].d : 1;
+
+		if (_rebuildAll || (slice >= _dirtyMin[axis] && slice <= _dirtyMax[axis]))
+		{
+			if (_meshMode == MeshMode::GREEDY)
+				generateGreedySlice(static_cast<BlockFace>(faceIdx), slice, mask, lights, blocks);
+			else
+				generateCubeSlice(slice);
+		}
+		else if (packed)
+		{
+			_packedBuffer.insert(_packedBuffer.end(), oldPackedBuffer.begin() + oldOffsets[section], oldPackedBuffer.begin() + oldOffsets[section + 1]);
+		}
+		else
+		{
+			_buffer.insert(_buffer.end(), oldBuffer.begin() + oldOffsets[section], oldBuffer.begin() + oldOffsets[section + 1]);
+		}
+	}
+
+	_sectionOffsets.push_back(packed ? _packedBuffer.size() : _buffer.size());
+
+	_shouldRender = (_sectionOffsets.back() > 0);
+
+	calculateGeometryBounds();
+	calculateSolidSides();
+
+	// the flood fill only runs when the solid blocks changed since it last ran
+	if (_connectionsStale)
+	{
+		if (_caveCulling)
+		{
+			calculateSideConnections();
+			_connectionsStale = false;
+		}
+		else
+		{
+			_sideConnections = 0x7FFF;
+		}
+	}
+
+	clearDirtyRegion();
 }
 
-void Chunk::setLightLevel(Block* block, int r, int g, int b, BlockFace face)
+void Chunk::calculateGeometryBounds()
 {
-	int idx = static_cast<int>(face);
+	int rows = _size * _size;
+
+	int min[3] = { _size, _size, _size };
+	int max[3] = { 0, 0, 0 };
+
+	int x, y;
+	for (y = 0; y < _size; ++y)
+	{
+		for (x = 0; x < _size; ++x)
+		{
+			int i = x + y * _size;
+
+			uint64_t visible =
+				_faceMasks[rows * 0 + i] | _faceMasks[rows * 1 + i] | _faceMasks[rows * 2 + i] |
+				_faceMasks[rows * 3 + i] | _faceMasks[rows * 4 + i] | _faceMasks[rows * 5 + i];
+
+			if (visible == 0) continue;
+
+			int z0 = lowestBit(visible);
+			int z1 = highestBit(visible);
+
+			min[0] = std::min(min[0], x);
+			min[1] = std::min(min[1], y);
+			min[2] = std::min(min[2], z0);
 
-	SET_LIGHT_LEVEL_R(block->lights[idx], r);
-	SET_LIGHT_LEVEL_G(block->lights[idx], g);
-	SET_LIGHT_LEVEL_B(block->lights[idx], b);
+			// corners are one past the block
+			max[0] = std::max(max[0], x + 1);
+			max[1] = std::max(max[1], y + 1);
+			max[2] = std::max(max[2], z1 + 1);
+		}
+	}
+
+	_hasGeometry = (min[0] < max[0]);
+
+	// an empty chunk keeps the whole chunk as its box, it is still sorted by distance for rebuilds
+	int i;
+	for (i = 0; i < 3; ++i)
+	{
+		_geometryMin[i] = _hasGeometry ? min[i] : 0;
+		_geometryMax[i] = _hasGeometry ? max[i] : _size;
+	}
 }
 
-void Chunk::render()
+void Chunk::calculateSolidSides()
 {
-	_mesh.bind();
-	_mesh.draw();
-	_mesh.unbind();
+	int padded = _size + 2;
+
+	// bits 1 to size of a padded row are inside the chunk
+	uint64_t inside = ((1ull << _size) - 1) << 1;
+
+	bool left = true, right = true, top = true, bottom = true, nearSide = true, farSide = true;
+
+	int x, y;
+	for (y = 0; y < _size; ++y)
+	{
+		for (x = 0; x < _size; ++x)
+		{
+			uint64_t row = _solidRows[(x + 1) + (y + 1) * padded];
+			bool full = (row & inside) == inside;
+
+			if (x == 0)         left   = left   && full;
+			if (x == _size - 1) right  = right  && full;
+			if (y == 0)         bottom = bottom && full;
+			if (y == _size - 1) top    = top    && full;
+
+			// the first and last block of every row
+			nearSide = nearSide && ((row >> 1) & 1) != 0;
+			farSide  = farSide  && ((row >> _size) & 1) != 0;
+		}
+	}
+
+	_solidSides =
+		(left     ? 1 << static_cast<int>(BlockFace::LEFT)   : 0) |
+		(right    ? 1 << static_cast<int>(BlockFace::RIGHT)  : 0) |
+		(top      ? 1 << static_cast<int>(BlockFace::TOP)    : 0) |
+		(bottom   ? 1 << static_cast<int>(BlockFace::BOTTOM) : 0) |
+		(nearSide ? 1 << static_cast<int>(BlockFace::NEAR)   : 0) |
+		(farSide  ? 1 << static_cast<int>(BlockFace::FAR)    : 0);
 }
 
-void Chunk::build()
+void Chunk::calculateSideConnections()
 {
-	_shouldRender = false;
+	_sideConnections = 0;
 
-	// clear existing data from the buffer
-	_buffer.clear();
+	int volume = _size * _size * _size;
 
-	// remove any sources that are listed
-	removeLightSources();
+	// local index x + y * size + z * size^2, kept per meshing thread so a remesh doesn't allocate
+	static thread_local std::vector<uint8_t> visited;
+	static thread_local std::vector<int>     stack;
 
-	// propagate any light sources in the chunk
-	propagateLight();
+	visited.assign(volume, 0);
+	stack.clear();
 
-	// iterate over each block and created the mesh
+	int start;
+	for (start = 0; start < volume && _sideConnections != 0x7FFF; ++start)
+	{
+		int sx = start % _size;
+		int sy = (start / _size) % _size;
+		int sz = start / (_size * _size);
 
-	int x, y, z;
+		if (visited[start] || isSnapshotSolid(sx, sy, sz)) continue;
+
+		// sides touched by this pocket of air
+		int sides = 0;
+
+		visited[start] = 1;
+		stack.push_back(start);
+
+		while (!stack.empty())
+		{
+			int idx = stack.back();
+			stack.pop_back();
+
+			int p[3] = { idx % _size, (idx / _size) % _size, idx / (_size * _size) };
+
+			int face;
+			for (face = 0; face < 6; ++face)
+			{
+				auto& f = FACE_AXES[face];
+
+				int n[3] = { p[0], p[1], p[2] };
+				n[f.d] += f.dir;
+
+				if (n[f.d] < 0 || n[f.d] >= _size)
+				{
+					sides |= 1 << face;
+					continue;
+				}
+
+				int next = n[0] + n[1] * _size + n[2] * _size * _size;
+
+				if (visited[next] || isSnapshotSolid(n[0], n[1], n[2])) continue;
+
+				visited[next] = 1;
+				stack.push_back(next);
+			}
+		}
+
+		int a, b;
+		for (a = 0; a < 6; ++a)
+			for (b = a + 1; b < 6; ++b)
+			{
+				if ((sides & (1 << a)) && (sides & (1 << b)))
+					_sideConnections |= 1 << getSidePairBit(a, b);
+			}
+	}
+}
+
+void Chunk::generateCubeSlice(int y)
+{
+	// walk the blocks with at least one visible face, a row along z at a time
 
+	int rows = _size * _size;
+
+	int x;
 	for (x = 0; x < _size; ++x)
 	{
-		for (y = 0; y < _size; ++y)
+		int i = x + y * _size;
+
+		uint64_t l = _faceMasks[rows * 0 + i];
+		uint64_t r = _faceMasks[rows * 1 + i];
+		uint64_t t = _faceMasks[rows * 2 + i];
+		uint64_t b = _faceMasks[rows * 3 + i];
+		uint64_t n = _faceMasks[rows * 4 + i];
+		uint64_t f = _faceMasks[rows * 5 + i];
+
+		uint64_t visible = l | r | t | b | n | f;
+
+		while (visible)
 		{
-			for (z = 0; z < _size; ++z)
+			int z = lowestBit(visible);
+			visible &= visible - 1;
+
+			Block block = getBlock(getIndex(x, y, z));
+
+			createCubeMesh(block, x, y, z,
+				((l >> z) & 1) != 0, ((r >> z) & 1) != 0,
+				((t >> z) & 1) != 0, ((b >> z) & 1) != 0,
+				((n >> z) & 1) != 0, ((f >> z) & 1) != 0);
+		}
+	}
+}
+
+void Chunk::generateGreedySlice(BlockFace face, int slice, std::vector<uint32_t>& mask, std::vector<uint64_t>& lights, std::vector<Block>& blocks)
+{
+	int faceIdx = static_cast<int>(face);
+	auto& f = FACE_AXES[faceIdx];
+
+	int rows = _size * _size;
+
+	int u, v;
+
+	// find the exposed faces in this slice, keyed by corner occlusion and block type with the corner lights
+	// alongside. 0 is no face
+	for (v = 0; v < _size; ++v)
+	{
+		for (u = 0; u < _size; ++u)
+		{
+			int pos[3];
+			pos[f.d] = slice;
+			pos[f.u] = u;
+			pos[f.v] = v;
+
+			uint64_t faces = _faceMasks[rows * faceIdx + pos[0] + pos[1] * _size];
+
+			uint32_t key = 0;
+
+			if ((faces >> pos[2]) & 1)
 			{
-				Block* block = getBlock(x, y, z);
+				Block& block = blocks[u + v * _size];
+
+				block = getBlock(getIndex(pos[0], pos[1], pos[2]));
+
+				uint8_t ao = getFaceShading(block, pos[0], pos[1], pos[2], face, lights[u + v * _size]);
+
+				key = ((uint32_t)ao << 24) | ((uint32_t)block.t << 16);
+			}
+
+			mask[u + v * _size] = key;
+		}
+	}
+
+	// merge matching faces into rectangles, growing along u first and then along v
+	for (v = 0; v < _size; ++v)
+	{
+		for (u = 0; u < _size;)
+		{
+			uint32_t key = mask[u + v * _size];
+
+			if (key == 0)
+			{
+				++u;
+				continue;
+			}
+
+			uint8_t ao = (uint8_t)(key >> 24);
+
+			uint64_t light = lights[u + v * _size];
 
-				// add this block if it is active
-				if (block->t)
+			// the occlusion and light are only interpolated correctly across a merged quad along the axes they don't
+			// change on
+			bool growU = getCornerOcclusion(ao, 0) == getCornerOcclusion(ao, 1) && getCornerOcclusion(ao, 3) == getCornerOcclusion(ao, 2) &&
+				getCornerLight(light, 0) == getCornerLight(light, 1) && getCornerLight(light, 3) == getCornerLight(light, 2);
+			bool growV = getCornerOcclusion(ao, 0) == getCornerOcclusion(ao, 3) && getCornerOcclusion(ao, 1) == getCornerOcclusion(ao, 2) &&
+				getCornerLight(light, 0) == getCornerLight(light, 3) && getCornerLight(light, 1) == getCornerLight(light, 2);
+
+			int w = 1;
+			while (growU && u + w < _size && mask[(u + w) + v * _size] == key && lights[(u + w) + v * _size] == light) ++w;
+
+			int h = 1;
+			bool done = !growV;
+			while (v + h < _size && !done)
+			{
+				int k;
+				for (k = 0; k < w; ++k)
 				{
-					// check if the adjacent blocks are active, if so don't create the joining face in the mesh
-					bool l, r, t, b, n, f;
+					if (mask[(u + k) + (v + h) * _size] != key || lights[(u + k) + (v + h) * _size] != light)
+					{
+						done = true;
+						break;
+					}
+				}
+
+				if (!done) ++h;
+			}
+
+			int plane = (f.dir > 0) ? slice + 1 : slice;
+			createQuad(blocks[u + v * _size], face, plane, u, v, w, h, ao, light);
+
+			// clear the merged faces
+			int i, j;
+			for (j = 0; j < h; ++j)
+				for (i = 0; i < w; ++i)
+					mask[(u + i) + (v + j) * _size] = 0;
+
+			u += w;
+		}
+	}
+}
+
+void Chunk::markBlockDirty(int x, int y, int z)
+{
+	int pos[] = { x, y, z };
+
+	// faces of the blocks around the changed one can appear or disappear too
+	int i;
+	for (i = 0; i < 3; ++i)
+	{
+		int lo = std::max(pos[i] - 1, 0);
+		int hi = std::min(pos[i] + 1, _size - 1);
+
+		_dirtyMin[i] = std::min(_dirtyMin[i], lo);
+		_dirtyMax[i] = std::max(_dirtyMax[i], hi);
+	}
+
+	// chunks that haven't been built yet are picked up by the visibility pass
+	bool wasSetup = !_dirty;
+
+	_dirty = true;
+
+	if (wasSetup && _updateCallback)
+		_updateCallback(this);
+}
+
+void Chunk::markAllDirty()
+{
+	int i;
+	for (i = 0; i < 3; ++i)
+	{
+		_dirtyMin[i] = 0;
+		_dirtyMax[i] = _size - 1;
+	}
+}
+
+void Chunk::clearDirtyRegion()
+{
+	// an empty region, min above max
+	int i;
+	for (i = 0; i < 3; ++i)
+	{
+		_dirtyMin[i] = _size;
+		_dirtyMax[i] = -1;
+	}
+
+	_rebuildAll = false;
+}
+
+void Chunk::createQuad(Block& block, BlockFace face, int plane, int u0, int v0, int w, int h, uint8_t ao, uint64_t lights)
+{
+	int d = FACE_AXES[static_cast<int>(face)].d;
+	int u = FACE_AXES[static_cast<int>(face)].u;
+	int v = FACE_AXES[static_cast<int>(face)].v;
+
+	// corners in block corner coordinates
+	int offsets[4][2] = { { 0, 0 }, { w, 0 }, { w, h }, { 0, h } };
+
+	// start at the second corner to move the diagonal the quad is split along
+	int first = shouldFlipQuad(ao) ? 1 : 0;
 
-					Block* adjacentBlock;
+	if (_vertexFormat == VertexFormat::PACKED)
+	{
+		int i;
+		for (i = 0; i < 4; ++i)
+		{
+			int k = (first + i) & 3;
+
+			int corner[3];
+			corner[d] = plane;
+			corner[u] = u0 + offsets[k][0];
+			corner[v] = v0 + offsets[k][1];
+
+			_packedBuffer.push_back(PackedVertex(corner[0], corner[1], corner[2], face, getCornerOcclusion(ao, k), getCornerLight(lights, k), block.t - 1));
+		}
+
+		return;
+	}
+
+	float X = _offset.x * (_size * _blockSize * 2);
+	float Y = _offset.y * (_size * _blockSize * 2);
+	float Z = _offset.z * (_size * _blockSize * 2);
 
-					adjacentBlock = getAdjacentBlock(block->x - 1, block->y, block->z);
-					l = (adjacentBlock == nullptr || adjacentBlock->t == 0);
+	float n[3] = { 0, 0, 0 };
+	n[d] = (float)FACE_AXES[static_cast<int>(face)].dir;
 
-					adjacentBlock = getAdjacentBlock(block->x + 1, block->y, block->z);
-					r = (adjacentBlock == nullptr || adjacentBlock->t == 0);
+	Vector3 normal(n[0], n[1], n[2]);
 
-					adjacentBlock = getAdjacentBlock(block->x, block->y + 1, block->z);
-					t = (adjacentBlock == nullptr || adjacentBlock->t == 0);
+	Vector4 region = getTileRegion(block);
 
-					adjacentBlock = getAdjacentBlock(block->x, block->y - 1, block->z);
-					b = (adjacentBlock == nullptr || adjacentBlock->t == 0);
+	// tile coordinates, the texture repeats once per block along each edge
+	Vector2 texCoords[4] = {
+		Vector2(0, 0),
+		Vector2(0, (float)w),
+		Vector2((float)h, (float)w),
+		Vector2((float)h, 0)
+	};
 
-					adjacentBlock = getAdjacentBlock(block->x, block->y, block->z - 1);
-					n = (adjacentBlock == nullptr || adjacentBlock->t == 0);
+	int i;
+	for (i = 0; i < 4; ++i)
+	{
+		int k = (first + i) & 3;
 
-					adjacentBlock = getAdjacentBlock(block->x, block->y, block->z + 1);
-					f = (adjacentBlock == nullptr || adjacentBlock->t == 0);
+		int corner[3];
+		corner[d] = plane;
+		corner[u] = u0 + offsets[k][0];
+		corner[v] = v0 + offsets[k][1];
 
-					createCubeMesh(*block, l, r, t, b, n, f);
-					_shouldRender = true;
-				}
-			}
-		}
-	}
+		Vector3 position(
+			((float)corner[0] * 2 * _blockSize + X) - _blockSize,
+			((float)corner[1] * 2 * _blockSize + Y) - _blockSize,
+			((float)corner[2] * 2 * _blockSize + Z) - _blockSize
+		);
 
-	_mesh.setDrawCount(_buffer.size() * 3);
+		Vertex vertex(position, normal, getBlockColor(getCornerLight(lights, k), ChunkMesh::AO_CURVE[getCornerOcclusion(ao, k)]));
+		vertex.texCoord = texCoords[k];
+		vertex.region   = region;
 
-	Buffer& vbo = _mesh.getVBO();
-	vbo.bind();
+		_buffer.push_back(vertex);
+	}
+}
 
-	if (_buffer.size() > 0)
+void Chunk::upload()
+{
+	if (_vertexFormat == VertexFormat::PACKED)
 	{
-		vbo.setData(&_buffer[0], _buffer.size() * sizeof(Chunk::Face));
+		if (_packedBuffer.size() > 0)
+			_mesh.setData(&_packedBuffer[0], _packedBuffer.size() * sizeof(PackedVertex), _packedBuffer.size());
+		else
+			_mesh.setData(0, 0, 0);
 	}
 	else
 	{
-		vbo.setData(0, 0);
+		if (_buffer.size() > 0)
+			_mesh.setData(&_buffer[0], _buffer.size() * sizeof(Vertex), _buffer.size());
+		else
+			_mesh.setData(0, 0, 0);
 	}
 
-	vbo.unbind();
-
 	_dirty = false;
 }
 
-void Chunk::createCubeMesh(Block& block, bool l, bool r, bool t, bool b, bool n, bool f)
+void Chunk::createCubeMesh(Block& block, int bx, int by, int bz, bool l, bool r, bool t, bool b, bool n, bool f)
 {
+	if (_vertexFormat == VertexFormat::PACKED)
+	{
+		// packed vertices use the face normal, so each face is a unit quad
+		bool visible[] = { l, r, t, b, n, f };
+		int coords[] = { bx, by, bz };
+
+		int i;
+		for (i = 0; i < 6; ++i)
+		{
+			if (!visible[i]) continue;
+
+			auto& axes = FACE_AXES[i];
+			int plane = (axes.dir > 0) ? coords[axes.d] + 1 : coords[axes.d];
+
+			uint64_t lights;
+			uint8_t ao = getFaceShading(block, bx, by, bz, static_cast<BlockFace>(i), lights);
+
+			createQuad(block, static_cast<BlockFace>(i), plane, coords[axes.u], coords[axes.v], 1, 1, ao, lights);
+		}
+
+		return;
+	}
+
 	// create the 8 vertices that make up the cube
 	// l - left, r - right  (x axis)
 	// t - top , b - bottom (y axis)
 	// n - near, f - far    (z axis)
 
-	float x = (float)block.x;
-	float y = (float)block.y;
-	float z = (float)block.z;
+	float x = (float)bx;
+	float y = (float)by;
+	float z = (float)bz;
 
 	float X = _offset.x * (_size * _blockSize * 2);
 	float Y = _offset.y * (_size * _blockSize * 2);
@@ -277,43 +1196,37 @@ void Chunk::createCubeMesh(Block& block, bool l, bool r, bool t, bool b, bool n,
 	// near face
 	if (n)
 	{
-		_buffer.push_back(makeFace(vLBN, vRBN, vRTN, block, true, getBlockColor(block, BlockFace::NEAR)));
-		_buffer.push_back(makeFace(vRTN, vLTN, vLBN, block, false, getBlockColor(block, BlockFace::NEAR)));
+		makeQuad(vLBN, vRBN, vRTN, vLTN, block, bx, by, bz, BlockFace::NEAR);
 	}
 
 	// far face
 	if (f)
 	{
-		_buffer.push_back(makeFace(vLBF, vRBF, vRTF, block, true, getBlockColor(block, BlockFace::FAR)));
-		_buffer.push_back(makeFace(vRTF, vLTF, vLBF, block, false, getBlockColor(block, BlockFace::FAR)));
+		makeQuad(vLBF, vRBF, vRTF, vLTF, block, bx, by, bz, BlockFace::FAR);
 	}
 
 	// left face
 	if (l)
 	{
-		_buffer.push_back(makeFace(vLBN, vLTN, vLTF, block, true, getBlockColor(block, BlockFace::LEFT)));
-		_buffer.push_back(makeFace(vLTF, vLBF, vLBN, block, false, getBlockColor(block, BlockFace::LEFT)));
+		makeQuad(vLBN, vLTN, vLTF, vLBF, block, bx, by, bz, BlockFace::LEFT);
 	}
 
 	// right face
 	if (r)
 	{
-		_buffer.push_back(makeFace(vRBN, vRTN, vRTF, block, true, getBlockColor(block, BlockFace::RIGHT)));
-		_buffer.push_back(makeFace(vRTF, vRBF, vRBN, block, false, getBlockColor(block, BlockFace::RIGHT)));
+		makeQuad(vRBN, vRTN, vRTF, vRBF, block, bx, by, bz, BlockFace::RIGHT);
 	}
 
 	// top face
 	if (t)
 	{
-		_buffer.push_back(makeFace(vLTN, vLTF, vRTF, block, true, getBlockColor(block, BlockFace::TOP)));
-		_buffer.push_back(makeFace(vRTF, vRTN, vLTN, block, false, getBlockColor(block, BlockFace::TOP)));
+		makeQuad(vLTN, vLTF, vRTF, vRTN, block, bx, by, bz, BlockFace::TOP);
 	}
 
 	// bottom face
 	if (b)
 	{
-		_buffer.push_back(makeFace(vLBN, vLBF, vRBF, block, true, getBlockColor(block, BlockFace::BOTTOM)));
-		_buffer.push_back(makeFace(vRBF, vRBN, vLBN, block, false, getBlockColor(block, BlockFace::BOTTOM)));
+		makeQuad(vLBN, vLBF, vRBF, vRBN, block, bx, by, bz, BlockFace::BOTTOM);
 	}
 }
 
@@ -327,565 +1240,328 @@ Vector3 Chunk::calculatePerVertexNormal(Vector3 x, Vector3 y, Vector3 z, bool ad
 	return result.normalize();
 }
 
-Chunk::Face Chunk::makeFace(Vertex& v1, Vertex& v2, Vertex& v3, Block block, bool firstHalf, ColorRGB32f& color)
-{
-	v1.color = color;
-	v2.color = color;
-	v3.color = color;
-
-	return textureFace(v1, v2, v3, block, firstHalf);
-}
-
-Chunk::Face Chunk::textureFace(Vertex& v1, Vertex& v2, Vertex& v3, Block block, bool firstHalf)
-{
-	// set vertex texture coordinates
-	Texture::TextureRegion region = VoxelEngine::getEngine()->getResources().getTextureManager().getAtlas(_atlasName).getRegion(block);
-
-	if (firstHalf)
-	{
-		v1.texCoord = region.topLeft;
-		v2.texCoord = region.bottomLeft;
-		v3.texCoord = region.bottomRight;
-	}
-	else
-	{
-		v1.texCoord = region.bottomRight;
-		v2.texCoord = region.topRight;
-		v3.texCoord = region.topLeft;
-	}
-
-	return Face(v1, v2, v3);
-}
-
-void Chunk::propagateLight()
+void Chunk::makeQuad(Vertex& v1, Vertex& v2, Vertex& v3, Vertex& v4, Block& block, int x, int y, int z, BlockFace face)
 {
-	// keep a set of all chunks that are affected by the light propagation
-	ChunkSet updateSet;
-
-	for (auto& source : _lightSourceList)
-	{
-		// breathe first searh queue of light nodes
-		std::queue<LightNode> bfsLightQueue;
-
-		bfsLightQueue.push(source.second);
-
-		while (!bfsLightQueue.empty())
-		{
-
-			// get the next node
-			LightNode node = bfsLightQueue.front();
-
-			// extract information
-
-			int x = (int)node.block->x;
-			int y = (int)node.block->y;
-			int z = (int)node.block->z;
-
-			Chunk* owner = node.owner;
-			updateSet.insert(owner);
-
-			// remove node from queue
-			bfsLightQueue.pop();
+	Vector4 region = getTileRegion(block);
 
-			//
-			LightNode adjacentNode;
+	uint64_t lights;
+	uint8_t ao = getFaceShading(block, x, y, z, face, lights);
 
-			adjacentNode = owner->getLightNode(x - 1, y, z);
+	v1.color = getBlockColor(getCornerLight(lights, 0), ChunkMesh::AO_CURVE[getCornerOcclusion(ao, 0)]);
+	v2.color = getBlockColor(getCornerLight(lights, 1), ChunkMesh::AO_CURVE[getCornerOcclusion(ao, 1)]);
+	v3.color = getBlockColor(getCornerLight(lights, 2), ChunkMesh::AO_CURVE[getCornerOcclusion(ao, 2)]);
+	v4.color = getBlockColor(getCornerLight(lights, 3), ChunkMesh::AO_CURVE[getCornerOcclusion(ao, 3)]);
 
-			if (adjacentNode.owner != nullptr && propagateLightPerFace(node, adjacentNode, BlockFace::LEFT))
-				bfsLightQueue.push(adjacentNode);
+	v1.region = region;
+	v2.region = region;
+	v3.region = region;
+	v4.region = region;
 
-			adjacentNode = owner->getLightNode(x + 1, y, z);
+	// tile coordinates of the corners
+	v1.texCoord = Vector2(0, 0); // top left
+	v2.texCoord = Vector2(0, 1); // bottom left
+	v3.texCoord = Vector2(1, 1); // bottom right
+	v4.texCoord = Vector2(1, 0); // top right
 
-			if (adjacentNode.owner != nullptr && propagateLightPerFace(node, adjacentNode, BlockFace::RIGHT))
-				bfsLightQueue.push(adjacentNode);
+	// start at the second corner to move the diagonal the quad is split along
+	Vertex* corners[4] = { &v1, &v2, &v3, &v4 };
 
-			adjacentNode = owner->getLightNode(x, y + 1, z);
+	int first = shouldFlipQuad(ao) ? 1 : 0;
 
-			if (adjacentNode.owner != nullptr && propagateLightPerFace(node, adjacentNode, BlockFace::TOP))
-				bfsLightQueue.push(adjacentNode);
-
-			adjacentNode = owner->getLightNode(x, y - 1, z);
-
-			if (adjacentNode.owner != nullptr && propagateLightPerFace(node, adjacentNode, BlockFace::BOTTOM))
-				bfsLightQueue.push(adjacentNode);
-
-			adjacentNode = owner->getLightNode(x, y, z - 1);
-
-			if (adjacentNode.owner != nullptr && propagateLightPerFace(node, adjacentNode, BlockFace::NEAR))
-				bfsLightQueue.push(adjacentNode);
+	int i;
+	for (i = 0; i < 4; ++i)
+		_buffer.push_back(*corners[(first + i) & 3]);
+}
 
-			adjacentNode = owner->getLightNode(x, y, z + 1);
+Vector4 Chunk::getTileRegion(Block& block)
+{
+	assert(_tileRegions != nullptr && block.t > 0 && (size_t)block.t <= _tileRegions->size());
 
-			if (adjacentNode.owner != nullptr && propagateLightPerFace(node, adjacentNode, BlockFace::FAR))
-				bfsLightQueue.push(adjacentNode);
-		}
-	}
+	return (*_tileRegions)[block.t - 1];
+}
 
-	// update all chunks affected
-	for (auto& chunk : updateSet)
-		chunk->markForUpdate();
+void Chunk::clearBlockLight(int idx, light_t channels)
+{
+	if (_lights.empty()) return;
 
+	int slots = getLightSlots();
 
+	int i;
+	for (i = 0; i < slots; ++i)
+		_lights[idx * slots + i] &= ~channels;
 }
 
-bool Chunk::propagateLightPerFace(LightNode& source, LightNode& adjacent, BlockFace face)
+ColorRGB32f Chunk::getBlockColor(light_t light, float occlusion)
 {
-	Block* sourceBlock   = source.block;
-	Block* adjacentBlock = adjacent.block;
+	// get the channel values
+	uint8_t ri = GET_LIGHT_LEVEL_R(light);
+	uint8_t gi = GET_LIGHT_LEVEL_G(light);
+	uint8_t bi = GET_LIGHT_LEVEL_B(light);
 
-	bool propagate = false;
+	// sky light is white
+	uint8_t si = GET_LIGHT_LEVEL_S(light);
 
-	// check if the light should propagate through the neighbour block
-	if (isBlockOpaque(*adjacentBlock))
-	{
-		bool f1, f2, f3, f4, f5;
+	ri = std::max(ri, si);
+	gi = std::max(gi, si);
+	bi = std::max(bi, si);
 
-		if (face == BlockFace::LEFT || face == BlockFace::RIGHT)
-		{
-			f1 = spreadLight(adjacent, BlockFace::NEAR,   sourceBlock->lights[(int)BlockFace::NEAR]);
-			f2 = spreadLight(adjacent, BlockFace::FAR,    sourceBlock->lights[(int)BlockFace::FAR]);
-			f3 = spreadLight(adjacent, BlockFace::TOP,    sourceBlock->lights[(int)BlockFace::TOP]);
-			f4 = spreadLight(adjacent, BlockFace::BOTTOM, sourceBlock->lights[(int)BlockFace::BOTTOM]);
+	// convert to floating point
+	float rf = (float)ri / (float)MAX_LIGHT_LEVEL * occlusion;
+	float gf = (float)gi / (float)MAX_LIGHT_LEVEL * occlusion;
+	float bf = (float)bi / (float)MAX_LIGHT_LEVEL * occlusion;
 
-			if (face == BlockFace::LEFT)
-			{
-				f5 = spreadLight(adjacent, BlockFace::RIGHT, sourceBlock->lights[(int)face]);
-			}
-			else
-			{
-				f5 = spreadLight(adjacent, BlockFace::LEFT, sourceBlock->lights[(int)face]);
-			}
-		}
-		else if (face == BlockFace::TOP || face == BlockFace::BOTTOM)
-		{
-			f1 = spreadLight(adjacent, BlockFace::LEFT,  sourceBlock->lights[(int)BlockFace::LEFT]);
-			f2 = spreadLight(adjacent, BlockFace::RIGHT, sourceBlock->lights[(int)BlockFace::RIGHT]);
-			f3 = spreadLight(adjacent, BlockFace::NEAR,  sourceBlock->lights[(int)BlockFace::NEAR]);
-			f4 = spreadLight(adjacent, BlockFace::FAR,   sourceBlock->lights[(int)BlockFace::FAR]);
+	//
+	return ColorRGB32f(rf, gf, bf);
+}
 
-			if (face == BlockFace::TOP)
-			{
-				f5 = spreadLight(adjacent, BlockFace::BOTTOM, sourceBlock->lights[(int)face]);
-			}
-			else
-			{
-				f5 = spreadLight(adjacent, BlockFace::TOP, sourceBlock->lights[(int)face]);
-			}
-		}
-		else //if (face == BlockFace::NEAR || face == BlockFace::FAR)
-		{
-			f1 = spreadLight(adjacent, BlockFace::LEFT,   sourceBlock->lights[(int)BlockFace::LEFT]);
-			f2 = spreadLight(adjacent, BlockFace::RIGHT,  sourceBlock->lights[(int)BlockFace::RIGHT]);
-			f3 = spreadLight(adjacent, BlockFace::TOP,    sourceBlock->lights[(int)BlockFace::TOP]);
-			f4 = spreadLight(adjacent, BlockFace::BOTTOM, sourceBlock->lights[(int)BlockFace::BOTTOM]);
+bool Chunk::isSetup(void) const
+{
+	return _dirty == false;
+}
 
-			if (face == BlockFace::NEAR)
-			{
-				f5 = spreadLight(adjacent, BlockFace::FAR, sourceBlock->lights[(int)face]);
-			}
-			else
-			{
-				f5 = spreadLight(adjacent, BlockFace::NEAR, sourceBlock->lights[(int)face]);
-			}
-		}
+bool Chunk::shouldRender(void)
+{
+	return _shouldRender;
+}
 
-		propagate = f1 || f2 || f3 || f4 || f5;
-	}
-	else
-	{
-		light_t sourceLevel = sourceBlock->lights[static_cast<int>(face)];
+bool Chunk::hasLocation(void) const
+{
+	return _hasLocation;
+}
 
-		bool f1, f2, f3, f4, f5, f6;
+void Chunk::setLocation(int x, int y, int z)
+{
+	_offset.x = (float)x;
+	_offset.y = (float)y;
+	_offset.z = (float)z;
 
-		f1 = spreadLight(adjacent, BlockFace::LEFT,   sourceLevel);
-		f2 = spreadLight(adjacent, BlockFace::RIGHT,  sourceLevel);
-		f3 = spreadLight(adjacent, BlockFace::TOP,    sourceLevel);
-		f4 = spreadLight(adjacent, BlockFace::BOTTOM, sourceLevel);
-		f5 = spreadLight(adjacent, BlockFace::NEAR,   sourceLevel);
-		f6 = spreadLight(adjacent, BlockFace::FAR,    sourceLevel);
+	_hasLocation = true;
+}
 
-		propagate = f1 || f2 || f3 || f4 || f5 || f6;
-	}
+Vector3 Chunk::getLocation(void)
+{
+	return _offset;
+}
 
-	return propagate;
+void Chunk::setMeshMode(MeshMode mode)
+{
+	_meshMode = mode;
+	_rebuildAll = true;
 }
 
-bool Chunk::spreadLight(LightNode& node, BlockFace face, light_t level)
+Chunk::MeshMode Chunk::getMeshMode(void) const
 {
-	// vectors corresponding to each face
-	static Vector3 neighbours[] = {
-		Vector3(-1,  0,  0), // left
-		Vector3( 1,  0,  0), // right
-		Vector3( 0,  1,  0), // top
-		Vector3( 0, -1,  0), // bottom
-		Vector3( 0,  0, -1), // near
-		Vector3( 0,  0,  1)  // far
-	};
+	return _meshMode;
+}
 
-	// get the face index
-	int idx = static_cast<int>(face);
+void Chunk::setVertexFormat(VertexFormat format)
+{
+	// packed vertices store block corners in a byte per axis
+	assert(format != VertexFormat::PACKED || _size < 256);
 
-	// the neighboring block
-	Vector3 neighbour = neighbours[idx];
-	Block* neighbourBlock = node.owner->getAdjacentBlock(
-		(int)node.block->x + (int)neighbour.x,
-		(int)node.block->y + (int)neighbour.y,
-		(int)node.block->z + (int)neighbour.z
-	);
+	_vertexFormat = format;
+	_mesh.setFormat(format);
+	_rebuildAll = true;
+}
 
-	// 
-	bool isNeighbourActive = (neighbourBlock != nullptr) && (neighbourBlock->t != 0);
+VertexFormat Chunk::getVertexFormat(void) const
+{
+	return _vertexFormat;
+}
 
-	// flag, whether or not to propagate light of this node for this face
-	bool propagate = false;
+void Chunk::setCaveCulling(bool enabled)
+{
+	_caveCulling = enabled;
 
-	// propagate the light, if the node is a air block (t == 0) of its neighbor is not active
-	if ((node.block->t == 0) || !isNeighbourActive)
+	// a built chunk whose connections were skipped is meshed again to find them
+	if (enabled && _connectionsStale && !_dirty)
 	{
-		// get the source lights channel values
-
-		int r1 = GET_LIGHT_LEVEL_R(level);
-		int g1 = GET_LIGHT_LEVEL_G(level);
-		int b1 = GET_LIGHT_LEVEL_B(level);
-
-		// get the current channel values
-
-		int r2 = GET_LIGHT_LEVEL_R(node.block->lights[idx]);
-		int g2 = GET_LIGHT_LEVEL_G(node.block->lights[idx]);
-		int b2 = GET_LIGHT_LEVEL_B(node.block->lights[idx]);
-
-		//
-		int newR = r2, newG = g2, newB = b2;
+		_dirty = true;
 
-		// if the current level is 2 or more less than the new level it can be brightened
-
-		if (r2 + 2 <= r1)
-		{
-			newR = r1 - 1;
-			propagate = true;
-		}
-
-		if (g2 + 2 <= g1)
-		{
-			newG = g1 - 1;
-			propagate = true;
-		}
-
-		if (b2 + 2 <= b1)
-		{
-			newB = b1 - 1;
-			propagate = true;
-		}
-
-		// set the new level
-		node.owner->setLightLevel(node.block, newR, newG, newB, face);
+		if (_updateCallback)
+			_updateCallback(this);
 	}
+}
 
-	// return propage
-	return propagate;
+unsigned int Chunk::getMeshSize(void) const
+{
+	return _mesh.getSize();
 }
 
-Chunk::LightNode Chunk::getLightNode(int x, int y, int z)
+unsigned int Chunk::getVertexCount(void) const
 {
-	if (x < 0)
-	{
-		if (this->left != nullptr)
-			return this->left->getLightNode(_size + x, y, z);
-		else
-			return LightNode(nullptr, nullptr);
-	}
-	else if (x >= _size)
-	{
-		if (this->right != nullptr)
-			return this->right->getLightNode(x - _size, y, z);
-		else
-			return LightNode(nullptr, nullptr);
-	}
+	return _mesh.getVertexCount();
+}
 
-	if (y < 0)
-	{
-		if (this->bottom != nullptr)
-			return this->bottom->getLightNode(x, _size + y, z);
-		else
-			return LightNode(nullptr, nullptr);
-	}
-	else if (y >= _size)
-	{
-		if (this->top != nullptr)
-			return this->top->getLightNode(x, y - _size, z);
-		else
-			return LightNode(nullptr, nullptr);
-	}
+unsigned int Chunk::getGeneratedVertexCount(void) const
+{
+	return _sectionOffsets.empty() ? 0 : _sectionOffsets.back();
+}
 
-	if (z < 0)
-	{
-		if (this->near != nullptr)
-			return this->near->getLightNode(x, y, _size + z);
-		else
-			return LightNode(nullptr, nullptr);
-	}
-	else if (z >= _size)
-	{
-		if (this->far != nullptr)
-			return this->far->getLightNode(x, y, z - _size);
-		else
-			return LightNode(nullptr, nullptr);
-	}
+unsigned int Chunk::getMemoryUsage(void) const
+{
+	return _blocks.getMemoryUsage() + (unsigned int)(_lights.capacity() * sizeof(light_t));
+}
 
-	Block* block = getBlock(x, y, z);
+void Chunk::setQuadIndexBuffer(const QuadIndexBuffer* indices)
+{
+	_mesh.setIndexBuffer(indices);
+}
 
-	return LightNode(block, this);
+void Chunk::setTileRegions(const std::vector<Vector4>* regions)
+{
+	_tileRegions = regions;
 }
 
-void Chunk::removeLightSources()
+void Chunk::calculateBounds(Matrix4& worldTransform)
 {
-	// store a list of chunks that need to be updated
-	ChunkSet updateSet;
+	// calculate the AABB of this chunk's geometry
 
-	// iterate over every node that needs to be removed
-	for (auto& iter : _lightRemovalList)
-	{
-		std::queue<LightNode> lightQueue;
-		std::map<Block*, int> intensities;
+	// the main offset for the chunk
+	float X = _offset.x * (_size * _blockSize * 2);
+	float Y = _offset.y * (_size * _blockSize * 2);
+	float Z = _offset.z * (_size * _blockSize * 2);
 
-		// add the source node to the FIFO queue
-		lightQueue.push(iter.second);
+	float lo[3] = {
+		((float)_geometryMin[0] * 2 * _blockSize + X) - _blockSize,
+		((float)_geometryMin[1] * 2 * _blockSize + Y) - _blockSize,
+		((float)_geometryMin[2] * 2 * _blockSize + Z) - _blockSize
+	};
 
-		// get the highest light intensity of each channel of each face
+	float hi[3] = {
+		((float)_geometryMax[0] * 2 * _blockSize + X) - _blockSize,
+		((float)_geometryMax[1] * 2 * _blockSize + Y) - _blockSize,
+		((float)_geometryMax[2] * 2 * _blockSize + Z) - _blockSize
+	};
 
-		int sourceIntensity = 0;
+	// the world transform may rotate the grid, so box all eight transformed corners
+	int i;
+	for (i = 0; i < 8; ++i)
+	{
+		Vector4 corner((i & 1) ? hi[0] : lo[0], (i & 2) ? hi[1] : lo[1], (i & 4) ? hi[2] : lo[2], 1);
+		Vector4 p = worldTransform * corner;
 
-		int i;
-		for (i = 0; i < 6; ++i)
+		if (i == 0)
 		{
-			int r = GET_LIGHT_LEVEL_R(iter.second.block->lights[i]);
-			int g = GET_LIGHT_LEVEL_G(iter.second.block->lights[i]);
-			int b = GET_LIGHT_LEVEL_B(iter.second.block->lights[i]);
-
-			sourceIntensity = std::max(std::max(std::max(r, g), b), sourceIntensity);
+			_boundsMin = Vector3(p.x, p.y, p.z);
+			_boundsMax = Vector3(p.x, p.y, p.z);
 		}
-
-		// clear the source block light
-		clearBlockLight(iter.second.block);
-
-		// set the intensity value in the map
-		intensities[iter.first] = sourceIntensity;
-
-		while (!lightQueue.empty())
+		else
 		{
-			LightNode source = lightQueue.front();
-
-			int x = (int)source.block->x;
-			int y = (int)source.block->y;
-			int z = (int)source.block->z;
-
-			lightQueue.pop();
-
-			// intensity of the current block
-			int intensity = intensities[source.block];
-
-			// 
-			if (intensity > 0)
-			{
-				// get every adjacent block to the current node and clear its light channels
-				// then add its owning chunk to the update set
-
-				LightNode adjacent;
-
-				adjacent = source.owner->getLightNode(x - 1, y, z);
-				clearLightNode(adjacent, lightQueue, intensities, intensity);
-				if (adjacent.owner != nullptr)
-					updateSet.insert(adjacent.owner);
-
-				adjacent = source.owner->getLightNode(x + 1, y, z);
-				clearLightNode(adjacent, lightQueue, intensities, intensity);
-				if (adjacent.owner != nullptr)
-					updateSet.insert(adjacent.owner);
-
-				adjacent = source.owner->getLightNode(x, y + 1, z);
-				clearLightNode(adjacent, lightQueue, intensities, intensity);
-				if (adjacent.owner != nullptr)
-					updateSet.insert(adjacent.owner);
-
-				adjacent = source.owner->getLightNode(x, y - 1, z);
-				clearLightNode(adjacent, lightQueue, intensities, intensity);
-				if (adjacent.owner != nullptr)
-					updateSet.insert(adjacent.owner);
-
-				adjacent = source.owner->getLightNode(x, y, z - 1);
-				clearLightNode(adjacent, lightQueue, intensities, intensity);
-				if (adjacent.owner != nullptr)
-					updateSet.insert(adjacent.owner);
-
-				adjacent = source.owner->getLightNode(x, y, z + 1);
-				clearLightNode(adjacent, lightQueue, intensities, intensity);
-				if (adjacent.owner != nullptr)
-					updateSet.insert(adjacent.owner);
-			}
+			_boundsMin = Vector3(std::min(_boundsMin.x, p.x), std::min(_boundsMin.y, p.y), std::min(_boundsMin.z, p.z));
+			_boundsMax = Vector3(std::max(_boundsMax.x, p.x), std::max(_boundsMax.y, p.y), std::max(_boundsMax.z, p.z));
 		}
-
-		iter.second.owner->getLightSourceMap().erase(iter.first);
 	}
 
-	for (auto& chunk : updateSet)
-		chunk->markForUpdate();
-
-	_lightRemovalList.clear();
+	_bounds.center = (_boundsMin + _boundsMax) / 2.0f;
+	_bounds.radius = (_boundsMax - _bounds.center).length();
 }
 
-void Chunk::clearLightNode(LightNode& node, std::queue<LightNode>& queue, std::map<Block*, int>& intensities, int intensity)
+Sphere& Chunk::getBounds()
 {
-	if (node.block != nullptr)
-	{
-		// if the block hasn't already been discovered
-		if (intensities.find(node.block) == intensities.end())
-		{
-			LightMap& sourceList = node.owner->getLightSourceMap();
+	return _bounds;
+}
 
-			// and the block isn't in the parent chunk's source list
-			if (sourceList.find(node.block) == sourceList.end())
-			{
-				queue.push(node);
-				intensities[node.block] = intensity - 1;
-				clearBlockLight(node.block);
-			}
-		}
-	}
+const Vector3& Chunk::getBoundsMin() const
+{
+	return _boundsMin;
 }
 
-void Chunk::clearBlockLight(Block* block)
+const Vector3& Chunk::getBoundsMax() const
 {
-	block->lights[0] = 0;
-	block->lights[1] = 0;
-	block->lights[2] = 0;
-	block->lights[3] = 0;
-	block->lights[4] = 0;
-	block->lights[5] = 0;
+	return _boundsMax;
 }
 
-ColorRGB32f Chunk::getBlockColor(Block& block, BlockFace face)
+bool Chunk::hasGeometry() const
 {
-	light_t light = block.lights[static_cast<int>(face)];
+	return _hasGeometry;
+}
 
-	// get the channel values
-	uint8_t ri = GET_LIGHT_LEVEL_R(light);
-	uint8_t gi = GET_LIGHT_LEVEL_G(light);
-	uint8_t bi = GET_LIGHT_LEVEL_B(light);
+uint8_t Chunk::getSolidSides() const
+{
+	return _solidSides;
+}
 
-	// convert to floating point
-	float rf = (float)ri / (float)CHNL_MASK;
-	float gf = (float)gi / (float)CHNL_MASK;
-	float bf = (float)bi / (float)CHNL_MASK;
+bool Chunk::areSidesConnected(BlockFace a, BlockFace b) const
+{
+	if (a == b) return true;
 
-	//
-	return ColorRGB32f(rf, gf, bf);
+	return (_sideConnections & (1 << getSidePairBit(static_cast<int>(a), static_cast<int>(b)))) != 0;
 }
 
-Chunk::LightNode Chunk::getLightNode(Block* block, BlockFace face)
+void Chunk::getSideQuad(BlockFace side, Matrix4& worldTransform, Vector3 corners[4]) const
 {
-	// get the node by getting the neighbor block that coresponds to the face
+	auto& f = FACE_AXES[static_cast<int>(side)];
 
-	switch (face)
-	{
-	case BlockFace::LEFT:
-		return getLightNode((int)block->x - 1, (int)block->y, (int)block->z);
-	case BlockFace::RIGHT:
-		return getLightNode((int)block->x + 1, (int)block->y, (int)block->z);
-	case BlockFace::TOP:
-		return getLightNode((int)block->x, (int)block->y + 1, (int)block->z);
-	case BlockFace::BOTTOM:
-		return getLightNode((int)block->x, (int)block->y - 1, (int)block->z);
-	case BlockFace::NEAR:
-		return getLightNode((int)block->x, (int)block->y, (int)block->z - 1);
-	case BlockFace::FAR:
-		return getLightNode((int)block->x, (int)block->y, (int)block->z + 1);
+	float X = _offset.x * (_size * _blockSize * 2);
+	float Y = _offset.y * (_size * _blockSize * 2);
+	float Z = _offset.z * (_size * _blockSize * 2);
 
-	default:
-		return LightNode(nullptr, nullptr);
-	}
-}
+	// corners of the side in block corner coordinates
+	int offsets[4][2] = { { 0, 0 }, { _size, 0 }, { _size, _size }, { 0, _size } };
 
-bool Chunk::isSetup(void) const
-{
-	return _dirty == false;
+	int i;
+	for (i = 0; i < 4; ++i)
+	{
+		int corner[3];
+		corner[f.d] = (f.dir > 0) ? _size : 0;
+		corner[f.u] = offsets[i][0];
+		corner[f.v] = offsets[i][1];
+
+		Vector4 p = worldTransform * Vector4(
+			((float)corner[0] * 2 * _blockSize + X) - _blockSize,
+			((float)corner[1] * 2 * _blockSize + Y) - _blockSize,
+			((float)corner[2] * 2 * _blockSize + Z) - _blockSize,
+			1
+		);
+
+		corners[i] = Vector3(p.x, p.y, p.z);
+	}
 }
 
-bool Chunk::shouldRender(void)
+void Chunk::setUpdateCallback(std::function<void(Chunk*)> callback)
 {
-	return _shouldRender;
+	_updateCallback = callback;
 }
 
-bool Chunk::hasLocation(void) const
+Chunk::LightMap& Chunk::getLightSourceMap()
 {
-	return _hasLocation;
+	return _lightSourceList;
 }
 
-void Chunk::setLocation(int x, int y, int z)
+std::vector<int>& Chunk::getLightRemovalList()
 {
-	_offset.x = (float)x;
-	_offset.y = (float)y;
-	_offset.z = (float)z;
-
-	_hasLocation = true;
+	return _lightRemovalList;
 }
 
-Vector3 Chunk::getLocation(void)
+std::vector<int>& Chunk::getPendingLights()
 {
-	return _offset;
+	return _pendingLights;
 }
 
-void Chunk::setAtlasName(const std::string& name)
+void Chunk::setLightChanged(bool changed)
 {
-	_atlasName = name;
+	_lightChanged = changed;
 }
 
-void Chunk::calculateBounds(Matrix4& worldTransform)
+bool Chunk::isLightChanged() const
 {
-	// calculate this chunks AABB
-
-	// the main offset for the chunk
-	float X = _offset.x * (_size * _blockSize * 2);
-	float Y = _offset.y * (_size * _blockSize * 2);
-	float Z = _offset.z * (_size * _blockSize * 2);
-
-	float maxBlockOffset = (float)(_size - 1);
-
-	// lbn vertex for block 0, 0, 0
-	Vector4 lbn;
-	lbn.x = (0 * 2 * _blockSize + X) - _blockSize;
-	lbn.y = (0 * 2 * _blockSize + Y) - _blockSize;
-	lbn.z = (0 * 2 * _blockSize + Z) - _blockSize;
-	lbn.w = 1;
-
-	// rtf vertex for block 15, 15, 15
-	Vector4 rtf;
-	rtf.x = (maxBlockOffset * 2 * _blockSize + X) + _blockSize;
-	rtf.y = (maxBlockOffset * 2 * _blockSize + Y) + _blockSize;
-	rtf.z = (maxBlockOffset * 2 * _blockSize + Z) + _blockSize;
-	rtf.w = 1;
-
-	Vector4 min = worldTransform * lbn;
-	Vector4 max = worldTransform * rtf;
-
-	Vector4 center = (max + min) / 2.0f;
-	_bounds.center = Vector3(center.x, center.y, center.z);
-	_bounds.radius = (Vector3(max.x, max.y, max.z) - _bounds.center).length();
+	return _lightChanged;
 }
 
-Sphere& Chunk::getBounds()
+void Chunk::setVisible(bool visible)
 {
-	return _bounds;
+	_visible = visible;
 }
 
-void Chunk::setUpdateCallback(std::function<void(Chunk*)> callback)
+bool Chunk::isVisible() const
 {
-	_updateCallback = callback;
+	return _visible;
 }
 
-Chunk::LightMap& Chunk::getLightSourceMap()
+int Chunk::getSize(void) const
 {
-	return _lightSourceList;
+	return _size;
 }
 
 void Chunk::markForUpdate()
@@ -894,6 +1570,9 @@ void Chunk::markForUpdate()
 
 	_updateCallback(this);
 	_dirty = true;
+
+	// the whole chunk may have changed, lighting or the atlas for example
+	_rebuildAll = true;
 }
 
 Chunk::~Chunk()
@@ -3,13 +3,13 @@
 #define CHUNK_H
 
 #include "Block.h"
+#include "ChunkMesh.h"
+#include "BlockStorage.h"
 
-#include <SGL/GL/Mesh.h>
 #include <SGL/Math/Sphere.h>
 #include <SGL/Math/Matrix4.h>
 
 #include <vector>
-#include <queue>
 #include <set>
 #include <map>
 #include <string>
@@ -21,37 +21,22 @@ namespace engine
 	{
 	public:
 
-		// Structure of a block's face
-		struct Face
-		{
-			Face(Vertex& v1, Vertex& v2, Vertex& v3) : v1(v1), v2(v2), v3(v3)
-			{
-			}
-
-			Vertex v1;
-			Vertex v2;
-			Vertex v3;
-		};
+		// light source colors keyed by block index
+		typedef std::map<int, light_t> LightMap;
 
-		// structure used for lighting
-		struct LightNode
+		// method used to generate the chunk mesh
+		enum class MeshMode
 		{
-			LightNode(Block* block, Chunk* owner) : block(block), owner(owner)
-			{
-			}
-
-			LightNode() : LightNode(nullptr, nullptr)
-			{
-			}
-
-			Block* block;
-			Chunk* owner;
+			CUBE,  // every exposed block face is meshed individually
+			GREEDY // coplanar faces of the same type and light are merged into larger quads
 		};
 
-		typedef std::map<Block*, LightNode> LightMap;
+		// the most blocks per axis, a row of blocks padded with a neighbor block at each end has to fit in a
+		// 64 bit word for face culling
+		static const int MAX_SIZE = 62;
 
 		/**
-			Initialize chunk with the number of block per each axis
+			Initialize chunk with the number of block per each axis, from 1 to MAX_SIZE
 		*/
 		Chunk(int size);
 
@@ -62,22 +47,81 @@ namespace engine
 		~Chunk();
 
 		/**
-			@return the block at (x, y, z) in this chunk
+			@return a copy of the block at (x, y, z) in this chunk
+		*/
+		Block getBlock(int x, int y, int z);
+
+		/**
+			@return a copy of block idx in this chunk
 		*/
-		Block* getBlock(int x, int y, int z);
+		Block getBlock(int idx) const;
 
 		/**
 			Get block at location (x, y, z).
 
 			The difference between this function and Block::getBlock is that it accounts for the 
-			coordinates to overflow into neighboring chunks
+			coordinates to overflow into neighboring chunks. Blocks outside of the grid are air
+		*/
+		Block getAdjacentBlock(int x, int y, int z);
+
+		/**
+			@return the type of the block at (x, y, z), accounting for neighboring chunks. 0 outside of the grid
+		*/
+		uint8_t getAdjacentBlockType(int x, int y, int z);
+
+		/**
+			@return the index of block (x, y, z) in this chunk
+		*/
+		int getIndex(int x, int y, int z) const;
+
+		/**
+			@return the type of block idx
+		*/
+		uint8_t getBlockType(int idx) const;
+
+		/**
+			@return the light of face of block idx. With per voxel light every face of a block has the same light
+		*/
+		light_t getLight(int idx, BlockFace face) const;
+
+		/**
+			Set the light of face of block idx
+		*/
+		void setLight(int idx, BlockFace face, light_t light);
+
+		/**
+			Clear the channels in the mask channels of every face of block idx
+		*/
+		void clearBlockLight(int idx, light_t channels);
+
+		/**
+			Set how the light of this chunk is stored. Clears the current light
+		*/
+		void setLightModel(LightModel model);
+		LightModel getLightModel(void) const;
+
+		/**
+			@return the number of blocks per axis
+		*/
+		int getSize(void) const;
+
+		/**
+			Build stage 1: copy the block types of this chunk and a one block border from its neighbors into
+			the padded snapshot used by the mesher. Must run on the main thread as it reads neighboring chunks
 		*/
-		Block* getAdjacentBlock(int x, int y, int z);
+		void takeSnapshot();
 
 		/**
-			Build the mesh for this chunk
+			Build stage 2: generate the vertex data for this chunk into the CPU side buffer.
+			Only the sections touching blocks changed by setBlock are regenerated, the rest is kept from the last build.
+			Only reads this chunk and its snapshot, so chunks can be meshed in parallel as long as no blocks are modified
 		*/
-		void build();
+		void generateMesh();
+
+		/**
+			Build stage 3: upload the generated vertex data to the GPU. Must run on the thread owning the GL context
+		*/
+		void upload();
 
 		/**
 			Render this chunk
@@ -95,7 +139,12 @@ namespace engine
 		void setLightSource(int x, int y, int z, int r, int g, int b);
 
 		/**
-			Remove light at (x, y, z)
+			Make block idx a light source of color light. Its light values are written by the light engine
+		*/
+		void setLightSource(int idx, light_t light);
+
+		/**
+			Queue the light source at (x, y, z) for removal. The light is cleared by the light engine
 		*/
 		void removeLight(int x, int y, int z);
 
@@ -125,12 +174,60 @@ namespace engine
 		sgl::Vector3 getLocation(void);
 
 		/**
-			Set the texture atlas name of this chunk
+			Set the method used to mesh this chunk
+		*/
+		void setMeshMode(MeshMode mode);
+
+		/**
+			@return the method used to mesh this chunk
+		*/
+		MeshMode getMeshMode(void) const;
+
+		/**
+			Set the vertex layout of this chunk's mesh. Must be called from the thread owning the GL context
+		*/
+		void setVertexFormat(VertexFormat format);
+
+		/**
+			@return the vertex layout of this chunk's mesh
+		*/
+		VertexFormat getVertexFormat(void) const;
+
+		/**
+			Find which sides are joined through air when meshing, for cave culling. While disabled all sides
+			count as connected. Disabled by default
+		*/
+		void setCaveCulling(bool enabled);
+
+		/**
+			@return the size in bytes of this chunk's uploaded vertex data
 		*/
-		void setAtlasName(const std::string& name);
+		unsigned int getMeshSize(void) const;
 
 		/**
-			Calculate the bounding volume of this chunk
+			@return the number of vertices in this chunk's uploaded mesh
+		*/
+		unsigned int getVertexCount(void) const;
+
+		/**
+			@return the number of vertices made by the last generateMesh, whether or not they were uploaded
+		*/
+		unsigned int getGeneratedVertexCount(void) const;
+
+		/**
+			Set the index buffer shared by the chunks of the grid
+		*/
+		void setQuadIndexBuffer(const QuadIndexBuffer* indices);
+
+		/**
+			Set the atlas regions as (u, v, width, height) indexed by block type - 1. The table is owned by the
+			chunk manager and must not change while the chunk is meshing
+		*/
+		void setTileRegions(const std::vector<sgl::Vector4>* regions);
+
+		/**
+			Calculate the bounding volume of this chunk. Once meshed the box only covers the blocks with visible
+			faces, before that it covers the whole chunk
 		*/
 		void calculateBounds(sgl::Matrix4& worldTransform);
 
@@ -139,6 +236,35 @@ namespace engine
 		*/
 		sgl::Sphere& getBounds();
 
+		/**
+			@return the corners of the world space box around the geometry of this chunk
+		*/
+		const sgl::Vector3& getBoundsMin() const;
+		const sgl::Vector3& getBoundsMax() const;
+
+		/**
+			@return false when the last mesh had no faces, all air or enclosed by solid blocks. True until the
+			chunk is first meshed
+		*/
+		bool hasGeometry() const;
+
+		/**
+			@return the sides of the chunk whose outer layer of blocks is all solid as of the last mesh, one bit
+			per BlockFace. These sides hide whatever is behind them
+		*/
+		uint8_t getSolidSides() const;
+
+		/**
+			Get the world space corners of the given side of the chunk, in order around its edge
+		*/
+		void getSideQuad(BlockFace side, sgl::Matrix4& worldTransform, sgl::Vector3 corners[4]) const;
+
+		/**
+			@return true if sides a and b of the chunk are joined by a path through air as of the last mesh.
+			All sides are connected until the chunk is first meshed with cave culling enabled
+		*/
+		bool areSidesConnected(BlockFace a, BlockFace b) const;
+
 		/**
 			Set the callback for when this chunk needs to be updated
 		*/
@@ -154,6 +280,34 @@ namespace engine
 		*/
 		LightMap& getLightSourceMap();
 
+		/**
+			@return the block indices of the light sources waiting to be removed
+		*/
+		std::vector<int>& getLightRemovalList();
+
+		/**
+			@return the block indices whose light has to be spread again, new light sources and edited blocks
+		*/
+		std::vector<int>& getPendingLights();
+
+		/**
+			Flag the chunk as having light values the mesh doesn't reflect yet, used by the light engine to
+			list each changed chunk once
+		*/
+		void setLightChanged(bool changed);
+		bool isLightChanged() const;
+
+		/**
+			Flag the chunk as being in the view frustum, set by the chunk manager when it culls the grid
+		*/
+		void setVisible(bool visible);
+		bool isVisible() const;
+
+		/**
+			@return the number of bytes used by the block and light data of this chunk
+		*/
+		unsigned int getMemoryUsage(void) const;
+
 	public:
 
 		Chunk* left;   // the chunk left neighbor
@@ -166,26 +320,68 @@ namespace engine
 	private:
 
 		// mesh for this chunk
-		sgl::Mesh _mesh;
-
-		// buffer of faces for each block of the mesh
-		std::vector<Face> _buffer;
+		ChunkMesh _mesh;
+
+		// buffer of quads for each block of the mesh, four vertices per quad
+		std::vector<Vertex> _buffer;
+		// buffer of quads when using the packed vertex format
+		std::vector<PackedVertex> _packedBuffer;
+
+		// start of each mesh section in the vertex buffer, plus the end of the last section
+		std::vector<unsigned int> _sectionOffsets;
+
+		// inclusive bounds of the blocks whose faces need to be remeshed, empty when min > max
+		int _dirtyMin[3];
+		int _dirtyMax[3];
+		// flag indicating every section has to be remeshed
+		bool _rebuildAll;
+
+		// block types of the chunk with a one block border from the neighbors, (size + 2)^3 entries
+		std::vector<uint8_t> _snapshot;
+		// solid bits of the snapshot, one word per padded row along z indexed by x + y * (size + 2)
+		std::vector<uint64_t> _solidRows;
+		// visible faces per BlockFace, one word per row along z indexed by face * size^2 + x + y * size
+		std::vector<uint64_t> _faceMasks;
+
+		// block corner coordinates of the box around the blocks with visible faces, the whole chunk until meshed
+		int  _geometryMin[3];
+		int  _geometryMax[3];
+		bool _hasGeometry;
+		// sides whose outer layer is all solid, a bit per BlockFace
+		uint8_t _solidSides;
+		// pairs of sides joined through air, a bit per pair
+		uint16_t _sideConnections;
+		// the solid blocks of the snapshot changed since the side connections were last found
+		bool _connectionsStale;
+		bool _caveCulling;
 
 		// the chunk offest
 		sgl::Vector3 _offset;
 
-		// list of blocks
-		std::vector<Block> _blocks;
-		// flag indicating if a blocks location has already been set
-		std::vector<bool> _hasLocationFlags;
+		// block types
+		BlockStorage _blocks;
+		// six face lights per block, or one per block with per voxel light. Only allocated once something in
+		// the chunk is lit
+		std::vector<light_t> _lights;
+		// light of the snapshot blocks with per voxel light, indexed the same as the snapshot
+		std::vector<light_t> _lightSnapshot;
 
 		// list of light sources
 		LightMap _lightSourceList;
 		// list os light sources to be removed
-		LightMap _lightRemovalList;
+		std::vector<int> _lightRemovalList;
+		// new light sources and edited blocks waiting for the light engine
+		std::vector<int> _pendingLights;
+
+		// resolved atlas regions of the block types
+		const std::vector<sgl::Vector4>* _tileRegions;
 
-		// the texture atlas name for this chunk
-		std::string _atlasName;
+		// method used to mesh this chunk
+		MeshMode _meshMode;
+		// how the light values are stored
+		LightModel _lightModel;
+		// vertex layout generated by the mesher
+		VertexFormat _vertexFormat;
 
 		// callback for when the chunk needs to be updated
 		std::function<void(Chunk*)> _updateCallback;
@@ -197,6 +393,10 @@ namespace engine
 
 		// flag indicated that the chunk need rebuilding
 		bool _dirty;
+		// flag indicating the light engine changed the light values since the last remesh was requested
+		bool _lightChanged;
+		// flag indicating the chunk was in the view frustum at the last cull
+		bool _visible;
 		// flag for is the chunk shoud be rendered
 		bool _shouldRender;
 
@@ -205,35 +405,73 @@ namespace engine
 
 		// spherical bounding area of the chunk
 		sgl::Sphere _bounds;
+		// world space box around the geometry
+		sgl::Vector3 _boundsMin;
+		sgl::Vector3 _boundsMax;
 
 	private:
 
-		// create the mesh for this block
-		void createCubeMesh(Block& block, bool l, bool r, bool t, bool b, bool n, bool far);
+		// index of block (x, y, z) in the snapshot, coordinates may be -1 or size
+		int getSnapshotIndex(int x, int y, int z) const;
+		bool isSnapshotSolid(int x, int y, int z) const;
+
+		// light of block (x, y, z), accounting for neighboring chunks. 0 outside of the grid
+		light_t getAdjacentLight(int x, int y, int z);
+
+		// number of light values stored per block
+		int getLightSlots(void) const;
 
 		/**
-			make a face of a block using the 3 vertices
+			ambient occlusion level of the four corners of a face of block (x, y, z) from the snapshot, 2 bits per
+			corner in the order quads are wound. 3 is an unoccluded corner. lights is set to the light of the
+			corners, 16 bits per corner in the same order. Per voxel light is averaged over the four cells around
+			each corner, per face light is the face's own
 		*/
-		Face makeFace(Vertex& v1, Vertex& v2, Vertex& v3, Block block, bool firstHalf, sgl::ColorRGB32f& color);
-		sgl::Vector3 calculatePerVertexNormal(sgl::Vector3 x, sgl::Vector3 y, sgl::Vector3 z, bool adjacentX, bool adjacentY, bool adjacentZ);
-		Face textureFace(Vertex& v1, Vertex& v2, Vertex& v3, Block block, bool firstHalf);
+		uint8_t getFaceShading(Block& block, int x, int y, int z, BlockFace face, uint64_t& lights) const;
+
+		// compute the visible face masks from the solid rows, 64 blocks at a time
+		void cullFaces();
+
+		// find the box around the blocks with visible faces from the face masks
+		void calculateGeometryBounds();
+		// find the solid sides from the solid rows
+		void calculateSolidSides();
+		// flood fill the air of the chunk to find which sides are joined
+		void calculateSideConnections();
+
+		// mesh each exposed block face of the y slice individually
+		void generateCubeSlice(int y);
+
+		// merge coplanar faces of a slice into quads, mask, lights and blocks are scratch space of size^2 entries
+		void generateGreedySlice(BlockFace face, int slice, std::vector<uint32_t>& mask, std::vector<uint64_t>& lights, std::vector<Block>& blocks);
+
+		// grow the dirty region by the block at (x, y, z) and the blocks around it
+		void markBlockDirty(int x, int y, int z);
+		void markAllDirty();
+		void clearDirtyRegion();
 
 		/**
-			Propagate the light sources
+			create a quad for a face lying on plane `plane` of the axis the face points along, spanning [u0, u0 + w]
+			and [v0, v0 + h] on the two axes spanning the face, with corner occlusion ao and corner lights lights
 		*/
-		void propagateLight();
-		bool propagateLightPerFace(LightNode& source, LightNode& block, BlockFace face);
-		bool spreadLight(LightNode& node, BlockFace face, light_t level);
-		void setLightLevel(Block* block, int r, int g, int b, BlockFace face);
+		void createQuad(Block& block, BlockFace face, int plane, int u0, int v0, int w, int h, uint8_t ao, uint64_t lights);
+
+		// create the mesh for the block at (x, y, z)
+		void createCubeMesh(Block& block, int x, int y, int z, bool l, bool r, bool t, bool b, bool n, bool far);
 
-		LightNode getLightNode(int x, int y, int z);
-		LightNode getLightNode(Block* block, BlockFace face);
+		/**
+			make a quad for a face of block (x, y, z) using the 4 corners, wound (v1, v2, v3) and (v3, v4, v1), or
+			(v2, v3, v4) and (v4, v1, v2) when the corner occlusion is darker along that diagonal
+		*/
+		void makeQuad(Vertex& v1, Vertex& v2, Vertex& v3, Vertex& v4, Block& block, int x, int y, int z, BlockFace face);
+		sgl::Vector3 calculatePerVertexNormal(sgl::Vector3 x, sgl::Vector3 y, sgl::Vector3 z, bool adjacentX, bool adjacentY, bool adjacentZ);
+		sgl::Vector4 getTileRegion(Block& block);
 
-		void removeLightSources();
-		void clearBlockLight(Block* block);
-		void clearLightNode(LightNode& node, std::queue<LightNode>& queue, std::map<Block*, int>& intensities, int intensity);
+		// find the chunk containing (x, y, z) and make the coordinates local to it
+		Chunk* getAdjacentChunk(int& x, int& y, int& z);
 
-		sgl::ColorRGB32f getBlockColor(Block& block, BlockFace face);
+		// color of a corner's light scaled by the ambient occlusion of the corner
+		sgl::ColorRGB32f getBlockColor(light_t light, float occlusion);
 	};
 }
 
@@ -0,0 +1,265 @@
+
+#include "ChunkCuller.h"
+#include "Chunk.h"
+
+#include <algorithm>
+
+using namespace engine;
+using namespace sgl;
+
+// squared distance from eye to the center of a chunk's box, the render order
+static inline float getDistance(Chunk* chunk, const Vector3& eye)
+{
+	Vector3 d = chunk->getBounds().center - eye;
+
+	return d.dot(d);
+}
+
+ChunkCuller::ChunkCuller(float guardDistance, float guardAngle) :
+	_hasGuard(false),
+	_guardDistance(guardDistance),
+	_guardAngle(guardAngle),
+	_sorted(0),
+	_reach(0),
+	_band(0),
+	_fullCulls(0),
+	_chunksTested(0)
+{
+}
+
+void ChunkCuller::setGuard(float distance, float angle)
+{
+	_guardDistance = distance;
+	_guardAngle    = angle;
+
+	// the candidates were found with the old guard
+	_hasGuard = false;
+}
+
+void ChunkCuller::reset()
+{
+	_hasGuard = false;
+}
+
+void ChunkCuller::update(Chunk* chunk)
+{
+	// the chunk is listed again from its new bounds, the old entry in _visible is dropped by the next cull
+	erase(chunk);
+
+	// the next walk finds every chunk
+	if (!_hasGuard || !chunk->hasGeometry()) return;
+
+	if (_guardFrustum.checkBox(chunk->getBoundsMin(), chunk->getBoundsMax(), _guardDistance, _guardAngle) == ViewFrustum::Side::OUTSIDE)
+		return;
+
+	Candidate candidate = { chunk, 0, false, false, false };
+
+	_indices[chunk] = _candidates.size();
+	_candidates.push_back(candidate);
+}
+
+void ChunkCuller::remove(Chunk* chunk)
+{
+	erase(chunk);
+}
+
+void ChunkCuller::cull(ChunkOctree& octree, const ViewFrustum& frustum, const Vector3& eye, std::vector<Chunk*>& visible)
+{
+	_chunksTested = 0;
+
+	float distance, angle;
+
+	bool guarded = _hasGuard && frustum.getMotion(_guardFrustum, distance, angle) &&
+		distance <= _guardDistance && angle <= _guardAngle;
+
+	// a move by distance and a turn by angle shift a corner r from the eye at most distance + angle * (r +
+	// distance), as in the guarded box test. No candidate is further than _reach
+	if (guarded)
+		patch(frustum, distance + angle * (_reach + distance), eye);
+	else
+		walk(octree, frustum, eye);
+
+	visible = _visible;
+}
+
+unsigned int ChunkCuller::getFullCullCount() const
+{
+	return _fullCulls;
+}
+
+unsigned int ChunkCuller::getChunksTested() const
+{
+	return _chunksTested;
+}
+
+void ChunkCuller::walk(ChunkOctree& octree, const ViewFrustum& frustum, const Vector3& eye)
+{
+	// only resident chunks can be seen, space that was never written to has no chunk. Whole regions of the
+	// octree are accepted or rejected by one test. The guard keeps every chunk the view can reach before
+	// the next walk
+	_guardFrustum = frustum;
+	_hasGuard     = true;
+
+	std::vector<Chunk*> chunks;
+	octree.cull(_guardFrustum, _guardDistance, _guardAngle, chunks);
+
+	_candidates.clear();
+	_indices.clear();
+	_visible.clear();
+
+	_reach = 0;
+
+	std::vector<Chunk*>::iterator iter;
+	for (iter = chunks.begin(); iter != chunks.end(); ++iter)
+	{
+		Chunk* chunk = (*iter);
+
+		float clearance;
+		ViewFrustum::Side side = frustum.checkBox(chunk->getBoundsMin(), chunk->getBoundsMax(), clearance);
+
+		++_chunksTested;
+
+		_reach = std::max(_reach, frustum.getReach(chunk->getBoundsMin(), chunk->getBoundsMax()));
+
+		bool seen = side != ViewFrustum::Side::OUTSIDE;
+
+		Candidate candidate = { chunk, clearance, seen, seen, seen };
+		_candidates.push_back(candidate);
+
+		if (seen)
+			_visible.push_back(chunk);
+	}
+
+	std::sort(_candidates.begin(), _candidates.end(), [](const Candidate& a, const Candidate& b)
+	{
+		return a.clearance < b.clearance;
+	});
+
+	size_t i;
+	for (i = 0; i < _candidates.size(); ++i)
+		_indices[_candidates[i].chunk] = i;
+
+	_sorted = _candidates.size();
+	_band   = _sorted;
+
+	std::sort(_visible.begin(), _visible.end(), [&eye](Chunk* a, Chunk* b)
+	{
+		return getDistance(a, eye) < getDistance(b, eye);
+	});
+
+	++_fullCulls;
+}
+
+void ChunkCuller::patch(const ViewFrustum& frustum, float shift, const Vector3& eye)
+{
+	// the band is the candidates whose corners may have shifted across a plane since the walk. Candidates that
+	// were in the band of the last cull and aren't anymore are back on their side at the walk
+	std::vector<Candidate>::iterator bandEnd = std::upper_bound(_candidates.begin(), _candidates.begin() + _sorted, shift,
+		[](float shift, const Candidate& candidate)
+	{
+		return shift < candidate.clearance;
+	});
+
+	size_t band = bandEnd - _candidates.begin();
+
+	// the candidates past both bands kept their side, the updated chunks after _sorted are always tested
+	size_t ranges[2][2] = { { 0, std::max(band, _band) }, { _sorted, _candidates.size() } };
+
+	_band = band;
+
+	int range;
+	size_t i;
+	for (range = 0; range < 2; ++range)
+	{
+		for (i = ranges[range][0]; i < ranges[range][1]; ++i)
+		{
+			Candidate& candidate = _candidates[i];
+
+			if (candidate.chunk == nullptr) continue;
+
+			if (i < band || i >= _sorted)
+				candidate.inView = testChunk(frustum, candidate.chunk);
+			else
+				candidate.inView = candidate.seen;
+		}
+	}
+
+	// keep the listed chunks still in view. Chunks removed or updated since the last cull aren't listed
+	size_t kept = 0;
+
+	std::vector<Chunk*>::iterator iter;
+	for (iter = _visible.begin(); iter != _visible.end(); ++iter)
+	{
+		std::unordered_map<Chunk*, size_t>::iterator found = _indices.find(*iter);
+
+		if (found == _indices.end()) continue;
+
+		Candidate& candidate = _candidates[found->second];
+
+		if (!candidate.listed) continue;
+
+		if (!candidate.inView)
+		{
+			candidate.listed = false;
+			continue;
+		}
+
+		_visible[kept++] = *iter;
+	}
+
+	_visible.resize(kept);
+
+	// the camera moved a little since the last cull, so the kept chunks are nearly in order
+	size_t j;
+	for (i = 1; i < kept; ++i)
+	{
+		Chunk* chunk = _visible[i];
+		float d = getDistance(chunk, eye);
+
+		for (j = i; j > 0 && getDistance(_visible[j - 1], eye) > d; --j)
+			_visible[j] = _visible[j - 1];
+
+		_visible[j] = chunk;
+	}
+
+	// add the chunks that came into view, only the ones just tested or back on their walked side can have
+	for (range = 0; range < 2; ++range)
+	{
+		for (i = ranges[range][0]; i < ranges[range][1]; ++i)
+		{
+			Candidate& candidate = _candidates[i];
+
+			if (candidate.chunk == nullptr || !candidate.inView || candidate.listed) continue;
+
+			candidate.listed = true;
+			_visible.push_back(candidate.chunk);
+		}
+	}
+
+	std::sort(_visible.begin() + kept, _visible.end(), [&eye](Chunk* a, Chunk* b)
+	{
+		return getDistance(a, eye) < getDistance(b, eye);
+	});
+
+	std::inplace_merge(_visible.begin(), _visible.begin() + kept, _visible.end(), [&eye](Chunk* a, Chunk* b)
+	{
+		return getDistance(a, eye) < getDistance(b, eye);
+	});
+}
+
+void ChunkCuller::erase(Chunk* chunk)
+{
+	std::unordered_map<Chunk*, size_t>::iterator found = _indices.find(chunk);
+
+	if (found == _indices.end()) return;
+
+	_candidates[found->second].chunk = nullptr;
+	_indices.erase(found);
+}
+
+bool ChunkCuller::testChunk(const ViewFrustum& frustum, Chunk* chunk)
+{
+	++_chunksTested;
+
+	return frustum.checkBox(chunk->getBoundsMin(), chunk->getBoundsMax()) != ViewFrustum::Side::OUTSIDE;
+}
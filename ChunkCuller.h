@@ -0,0 +1,116 @@
+
+#ifndef CHUNKCULLER_H
+#define CHUNKCULLER_H
+
+#include "ChunkOctree.h"
+#include "ViewFrustum.h"
+
+#include <SGL/Math/Vector3.h>
+
+#include <vector>
+#include <unordered_map>
+
+namespace engine
+{
+	class Chunk;
+
+	/**
+		Frustum culling of the resident chunks that reuses the last result while the view stays near the frustum
+		of the last octree walk.
+
+		A walk finds the chunks that may be seen while the camera moves up to the guard distance and turns up to
+		the guard angle, and records how far each of them is from crossing a plane of the walked frustum. A
+		chunk can only change sides once the motion since the walk shifts its corners further than that, so a
+		cull within the guard tests the band of chunks near the planes and keeps the side of the others. The
+		band is the front of the candidates sorted by clearance. The visible list of the last cull is kept in order
+		and patched, so a cull costs the band tests and a pass over the visible chunks instead of a walk, a test
+		of every candidate and a sort
+	*/
+	class ChunkCuller
+	{
+	public:
+
+		ChunkCuller(float guardDistance, float guardAngle);
+
+		/**
+			Set how far in world units and how many radians the view can move and turn before the octree is
+			walked again
+		*/
+		void setGuard(float distance, float angle);
+
+		/**
+			Walk the octree on the next cull, after every chunk moved
+		*/
+		void reset();
+
+		/**
+			Record a chunk that was added to the octree or whose bounds changed. It is tested every cull until
+			the next walk
+		*/
+		void update(Chunk* chunk);
+
+		/**
+			Forget a chunk before it is deleted
+		*/
+		void remove(Chunk* chunk);
+
+		/**
+			Set visible to the chunks with geometry intersecting frustum, front to back from eye
+		*/
+		void cull(ChunkOctree& octree, const ViewFrustum& frustum, const sgl::Vector3& eye, std::vector<Chunk*>& visible);
+
+		/**
+			@return the number of octree walks so far
+		*/
+		unsigned int getFullCullCount() const;
+
+		/**
+			@return the number of chunks tested against the frustum by the last cull, without the octree nodes
+		*/
+		unsigned int getChunksTested() const;
+
+	private:
+
+		struct Candidate
+		{
+			Chunk* chunk;      // null once the chunk was removed or updated
+			float  clearance;  // distance the corners can shift before the chunk changes sides
+			bool   seen;       // intersects the frustum of the walk
+			bool   inView;     // intersects the frustum of the last cull
+			bool   listed;     // in _visible
+		};
+
+		ViewFrustum _guardFrustum;
+		bool        _hasGuard;
+		float       _guardDistance;
+		float       _guardAngle;
+
+		// chunks within the guard of the last walk sorted by clearance, then the chunks updated since
+		std::vector<Candidate> _candidates;
+		size_t                 _sorted;
+		// distance from the eye of the walk to the furthest candidate corner
+		float                  _reach;
+		// index of each chunk in _candidates
+		std::unordered_map<Chunk*, size_t> _indices;
+		// candidates in the band of the last cull
+		size_t _band;
+
+		// result of the last cull, front to back
+		std::vector<Chunk*> _visible;
+
+		unsigned int _fullCulls;
+		unsigned int _chunksTested;
+
+	private:
+
+		void walk(ChunkOctree& octree, const ViewFrustum& frustum, const sgl::Vector3& eye);
+		void patch(const ViewFrustum& frustum, float shift, const sgl::Vector3& eye);
+
+		// drop a chunk from the candidates, its slot is left empty until the next walk
+		void erase(Chunk* chunk);
+
+		bool testChunk(const ViewFrustum& frustum, Chunk* chunk);
+	};
+}
+
+#endif
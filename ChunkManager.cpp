@@ -2,28 +2,74 @@
 #include "ChunkManager.h"
 
 #include "VoxelEngine.h"
+#include "FatalError.h"
 
 #include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
 
 using namespace engine;
 using namespace sgl;
 
+// pack chunk coordinates into a map key, 21 bits per axis so negative coordinates keep their own keys
+static inline uint64_t getChunkKey(int x, int y, int z)
+{
+	return ((uint64_t)(x & 0x1FFFFF)) | ((uint64_t)(y & 0x1FFFFF) << 21) | ((uint64_t)(z & 0x1FFFFF) << 42);
+}
+
 ChunkManager::ChunkManager(int x, int y, int z, const char *atlasName) : ChunkManager(x, y, z, 16, 1, atlasName)
 {
 }
 
 ChunkManager::ChunkManager(int x, int y, int z, int blocksPerChunk, float blockSize, const char *atlasName) :
+	ChunkManager(x, y, z, blocksPerChunk, blockSize, atlasName, LightModel::PER_FACE)
+{
+}
+
+ChunkManager::ChunkManager(int x, int y, int z, int blocksPerChunk, float blockSize, const char *atlasName, LightModel lightModel) :
 	_blockX(x),
 	_blockY(y),
 	_blockZ(z),
 	_blocksPerChunk(blocksPerChunk),
 	_blockSize(blockSize),
-	_rebuildsPerFrame(5),
-	_atlasName(atlasName),
+	_rebuildBudget(4000),
+	_frame(1),
+	_lastEditFrame(0),
 	_renderDebug(false),
-	_updateBoundingVolume(true)
+	_meshMode(Chunk::MeshMode::CUBE),
+	_vertexFormat(VertexFormat::FLOAT),
+	_tileRegionsGeneration(0),
+	_lightModel(lightModel),
+	_lightEngine(lightModel),
+	_parallelLighting(true),
+	_skyLight(false),
+	_nextSkyColumn(0),
+	_skyColumnsPerFrame(1024),
+	_loadRadius(0),
+	_unloadRadius(0),
+	_loadsPerFrame(8),
+	_nextLoad(0),
+	_streamCenterValid(false),
+	_evictionTime(0),
+	_evictions(0),
+	_evictionsPerSecond(0),
+	_atlasName(atlasName),
+	_updateBoundingVolume(true),
+	_hasFrustum(false),
+	_visibilityDirty(false),
+	_culler(blocksPerChunk * blockSize, 0.2f),
+	_caveCulling(false),
+	_occlusionBuffer(128, 64),
+	_occlusionCulling(false),
+	_occluderRadius(4),
+	_occludedChunks(0),
+	_occlusionTime(0)
 {
-	allocateChunks(blocksPerChunk, blockSize);
+	if (blocksPerChunk < 1 || blocksPerChunk > Chunk::MAX_SIZE)
+		fatalError("Error: blocksPerChunk must be 1 to " + std::to_string(Chunk::MAX_SIZE) + ", not " + std::to_string(blocksPerChunk));
+
+	_quadIndices.create(QuadIndexBuffer::getMaxChunkQuads(blocksPerChunk));
 
 	_worldTransform.toTranslation(0, 0, 0);
 }
@@ -36,42 +82,244 @@ void ChunkManager::update()
 		_updateBoundingVolume = false;
 	}
 
+	updateTileRegions();
+	updateStreaming();
+	updateLighting();
+
+	// the light queues may point at unloaded chunks until they are spread
+	unloadChunks();
+
 	rebuildChunks();
+
+	// loaded, unloaded and rebuilt chunks enter and leave the render list without waiting for the view to move
+	if (_visibilityDirty && _hasFrustum)
+		cullChunks();
+
+	++_frame;
 }
 
-void ChunkManager::updateVisiblityList(Frustum& frustum)
+void ChunkManager::updateVisiblityList(ViewFrustum& frustum)
 {
-	// clear the current chunks
-	_chunkRenderSet.clear();
+	_frustum    = frustum;
+	_hasFrustum = true;
 
-	int i, j, k;
+	cullChunks();
+}
 
-	for (i = 0; i < _size; ++i)
+void ChunkManager::cullChunks()
+{
+	ChunkList::iterator iter;
+	for (iter = _renderList.begin(); iter != _renderList.end(); ++iter)
+		(*iter)->setVisible(false);
+
+	// front to back from the view
+	_culler.cull(_octree, _frustum, _viewPosition, _renderList);
+
+	if (_caveCulling)
+		cullUnreachableChunks();
+
+	if (_occlusionCulling)
+		cullOccludedChunks();
+
+	for (iter = _renderList.begin(); iter != _renderList.end(); ++iter)
 	{
-		for (j = 0; j < _size; ++j)
-		{
-			for (k = 0; k < _size; ++k)
-			{
-				Chunk& chunk = getChunk(i, j, k);
+		Chunk* chunk = (*iter);
+		chunk->setVisible(true);
 
-				Sphere& bounds = chunk.getBounds();
+		if (!chunk->isSetup())
+			_chunkRebuildSet.insert(chunk);
+	}
 
-				Frustum::Side side = frustum.checkSphere(bounds);
+	_visibilityDirty = false;
+}
+
+void ChunkManager::setVisibilityGuard(float distance, float angle)
+{
+	_culler.setGuard(distance, angle);
 
-				if (side == Frustum::Side::INSIDE || side == Frustum::Side::INTERSECT)
+	_visibilityDirty = true;
+}
+
+unsigned int ChunkManager::getFullCullCount() const
+{
+	return _culler.getFullCullCount();
+}
+
+unsigned int ChunkManager::getNodesTested() const
+{
+	return _octree.getNodesTested();
+}
+
+unsigned int ChunkManager::getVisibleChunkCount() const
+{
+	return (unsigned int)_renderList.size();
+}
+
+void ChunkManager::cullOccludedChunks()
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	_occlusionBuffer.clear(_frustum);
+
+	// the solid sides of the chunks around the view hide the most, chunks further out only cover a few pixels
+	ChunkCoord center = getViewChunk();
+
+	Vector3 corners[4];
+
+	int x, y, z;
+	for (x = center.x - _occluderRadius; x <= center.x + _occluderRadius; ++x)
+		for (y = center.y - _occluderRadius; y <= center.y + _occluderRadius; ++y)
+			for (z = center.z - _occluderRadius; z <= center.z + _occluderRadius; ++z)
+			{
+				Chunk* chunk = findChunk(x, y, z);
+
+				if (chunk == nullptr || chunk->getSolidSides() == 0) continue;
+
+				int side;
+				for (side = 0; side < 6; ++side)
 				{
-					if (chunk.isSetup())
-					{
-						_chunkRenderSet.insert(&chunk);
-					}
-					else
-					{
-						_chunkRebuildSet.insert(&chunk);
-					}
+					if ((chunk->getSolidSides() & (1 << side)) == 0) continue;
+
+					chunk->getSideQuad(static_cast<BlockFace>(side), _worldTransform, corners);
+					_occlusionBuffer.drawQuad(corners);
 				}
 			}
+
+	// keep the chunks with any pixel in front of the occluders, in the same order
+	size_t count = _renderList.size();
+
+	ChunkList::iterator last = std::remove_if(_renderList.begin(), _renderList.end(), [this](Chunk* chunk)
+	{
+		return _occlusionBuffer.isOccluded(chunk->getBoundsMin(), chunk->getBoundsMax());
+	});
+
+	_renderList.erase(last, _renderList.end());
+
+	_occludedChunks = (unsigned int)(count - _renderList.size());
+	_occlusionTime  = (float)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ChunkManager::cullUnreachableChunks()
+{
+	struct Step
+	{
+		ChunkCoord coord;
+		int        from;       // side of the chunk the walk entered through, -1 for the view chunk
+		int        directions; // faces stepped through so far, a bit per BlockFace
+	};
+
+	// chunk steps per BlockFace
+	static const int STEPS[6][3] = {
+		{ -1, 0, 0 }, { 1, 0, 0 },
+		{ 0, 1, 0 }, { 0, -1, 0 },
+		{ 0, 0, -1 }, { 0, 0, 1 }
+	};
+
+	_reachedChunks.clear();
+
+	std::vector<Step> queue;
+
+	Step start = { getViewChunk(), -1, 0 };
+	queue.push_back(start);
+	_reachedChunks.insert(getChunkKey(start.coord.x, start.coord.y, start.coord.z));
+
+	// breadth first, missing chunks are air and joined on all sides. The frustum bounds the walk
+	size_t next;
+	for (next = 0; next < queue.size(); ++next)
+	{
+		Step step = queue[next];
+
+		Chunk* chunk = findChunk(step.coord.x, step.coord.y, step.coord.z);
+
+		int face;
+		for (face = 0; face < 6; ++face)
+		{
+			// opposite faces differ in the lowest bit, going back would reach chunks already seen from closer
+			if (step.directions & (1 << (face ^ 1))) continue;
+
+			if (step.from >= 0 && chunk != nullptr && !chunk->areSidesConnected(static_cast<BlockFace>(step.from), static_cast<BlockFace>(face)))
+				continue;
+
+			ChunkCoord coord = { step.coord.x + STEPS[face][0], step.coord.y + STEPS[face][1], step.coord.z + STEPS[face][2] };
+
+			uint64_t key = getChunkKey(coord.x, coord.y, coord.z);
+
+			if (_reachedChunks.find(key) != _reachedChunks.end()) continue;
+
+			Vector3 min, max;
+			getChunkBox(coord.x, coord.y, coord.z, min, max);
+
+			if (_frustum.checkBox(min, max) == ViewFrustum::Side::OUTSIDE) continue;
+
+			_reachedChunks.insert(key);
+
+			Step neighbor = { coord, face ^ 1, step.directions | (1 << face) };
+			queue.push_back(neighbor);
 		}
 	}
+
+	ChunkList::iterator last = std::remove_if(_renderList.begin(), _renderList.end(), [this](Chunk* chunk)
+	{
+		Vector3 loc = chunk->getLocation();
+
+		return _reachedChunks.find(getChunkKey((int)loc.x, (int)loc.y, (int)loc.z)) == _reachedChunks.end();
+	});
+
+	_renderList.erase(last, _renderList.end());
+}
+
+void ChunkManager::getChunkBox(int x, int y, int z, Vector3& min, Vector3& max)
+{
+	float chunkRenderSize = (float)(_blocksPerChunk * _blockSize * 2);
+
+	// blocks are centered on their coordinates
+	float lo[3] = { x * chunkRenderSize - _blockSize, y * chunkRenderSize - _blockSize, z * chunkRenderSize - _blockSize };
+	float hi[3] = { lo[0] + chunkRenderSize, lo[1] + chunkRenderSize, lo[2] + chunkRenderSize };
+
+	int i;
+	for (i = 0; i < 8; ++i)
+	{
+		Vector4 p = _worldTransform * Vector4((i & 1) ? hi[0] : lo[0], (i & 2) ? hi[1] : lo[1], (i & 4) ? hi[2] : lo[2], 1);
+
+		if (i == 0)
+		{
+			min = Vector3(p.x, p.y, p.z);
+			max = Vector3(p.x, p.y, p.z);
+		}
+		else
+		{
+			min = Vector3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+			max = Vector3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+		}
+	}
+}
+
+void ChunkManager::setCaveCulling(bool enabled)
+{
+	_caveCulling     = enabled;
+	_visibilityDirty = true;
+
+	for (auto& entry : _chunks)
+		entry.second->setCaveCulling(enabled);
+}
+
+void ChunkManager::setOcclusionCulling(bool enabled)
+{
+	_occlusionCulling = enabled;
+	_occludedChunks   = 0;
+	_occlusionTime    = 0;
+
+	_visibilityDirty = true;
+}
+
+unsigned int ChunkManager::getOccludedChunkCount() const
+{
+	return _occludedChunks;
+}
+
+float ChunkManager::getOcclusionTime() const
+{
+	return _occlusionTime;
 }
 
 void ChunkManager::translate(float x, float y, float z)
@@ -94,8 +342,15 @@ void ChunkManager::scale(float s)
 
 void ChunkManager::render()
 {
-	ChunkSet::iterator iter;
-	for (iter = _chunkRenderSet.begin(); iter != _chunkRenderSet.end(); ++iter)
+	if (_vertexFormat == VertexFormat::PACKED)
+	{
+		updateTileRegions();
+		ChunkMesh::setPackedUniforms(_blockSize, _tileRegionBuffer);
+	}
+
+	// front to back, so the depth test rejects hidden fragments early
+	ChunkList::iterator iter;
+	for (iter = _renderList.begin(); iter != _renderList.end(); ++iter)
 	{
 		Chunk* chunk = (*iter);
 		
@@ -108,16 +363,17 @@ void ChunkManager::render()
 
 void ChunkManager::updateChunkVolumes()
 {
-	int i, j, k;
-	for (i = 0; i < _size; ++i)
-		for (j = 0; j < _size; ++j)
-			for (k = 0; k < _size; ++k)
-			{
-				Chunk& chunk = getChunk(i, j, k);
-				chunk.calculateBounds(_worldTransform);
-			}
+	ChunkMap::iterator iter;
+	for (iter = _chunks.begin(); iter != _chunks.end(); ++iter)
+		iter->second->calculateBounds(_worldTransform);
 
+	_octree.updateBounds();
+
+	// every chunk moved, the candidates have to be found again
 	_updateBoundingVolume = false;
+	_visibilityDirty      = true;
+
+	_culler.reset();
 }
 
 Block ChunkManager::getBlockFromWorldPosition(const sgl::Vector3& p)
@@ -127,143 +383,841 @@ Block ChunkManager::getBlockFromWorldPosition(const sgl::Vector3& p)
 
 Block ChunkManager::getBlockFromWorldPosition(float x, float y, float z)
 {
-	float blockRenderSize = _blockSize * 2;
-
-	int blockX = (int)(x / blockRenderSize);
-	int blockY = (int)(y / blockRenderSize);
-	int blockZ = (int)(z / blockRenderSize);
+	int blockX, blockY, blockZ;
+	getGridBlock(Vector3(x, y, z), blockX, blockY, blockZ);
 
 	return getBlock(blockX, blockY, blockZ);
 }
 
-Chunk& ChunkManager::getChunkFromWorldPosition(const sgl::Vector3& pos)
+Chunk* ChunkManager::getChunkFromWorldPosition(const sgl::Vector3& pos)
 {
 	return getChunkFromWorldPosition(pos.x, pos.y, pos.z);
 }
 
-Chunk& ChunkManager::getChunkFromWorldPosition(float x, float y, float z)
+Chunk* ChunkManager::getChunkFromWorldPosition(float x, float y, float z)
 {
-	// world space size of a chunk
-	float chunkRenderSize = (float)(_blocksPerChunk * _blockSize * 2);
-
-	// get the x,y,z indices of the chunk at given location 
+	int blockX, blockY, blockZ;
+	getGridBlock(Vector3(x, y, z), blockX, blockY, blockZ);
 
-	int chunkX = (int)(x / chunkRenderSize);
-	int chunkY = (int)(y / chunkRenderSize);
-	int chunkZ = (int)(z / chunkRenderSize);
-
-	//
-	return getChunk(chunkX, chunkY, chunkZ);
+	// a lookup must not create chunks in the sparse map
+	return findChunk(getChunkCoord(blockX), getChunkCoord(blockY), getChunkCoord(blockZ));
 }
 
 Block ChunkManager::getBlock(int x, int y, int z)
 {
-	int chunkX = x / _blocksPerChunk;
-	int chunkY = y / _blocksPerChunk;
-	int chunkZ = z / _blocksPerChunk;
-
-	int blockX = x % _blocksPerChunk;
-	int blockY = y % _blocksPerChunk;
-	int blockZ = z % _blocksPerChunk;
+	Chunk* chunk = findChunk(getChunkCoord(x), getChunkCoord(y), getChunkCoord(z));
 
-	Chunk& chunk = getChunk(chunkX, chunkY, chunkZ);
+	// space without a chunk is air
+	if (chunk == nullptr) return Block();
 
-	return *chunk.getBlock(blockX, blockY, blockZ);
+	return chunk->getBlock(getLocalCoord(x), getLocalCoord(y), getLocalCoord(z));
 }
 
 void ChunkManager::setBlock(int x, int y, int z, int t)
 {
-	int chunkX = x / _blocksPerChunk;
-	int chunkY = y / _blocksPerChunk;
-	int chunkZ = z / _blocksPerChunk;
+	// clearing a block of space without a chunk changes nothing
+	if (t == 0 && findChunk(getChunkCoord(x), getChunkCoord(y), getChunkCoord(z)) == nullptr) return;
+
+	Chunk& chunk = getChunk(getChunkCoord(x), getChunkCoord(y), getChunkCoord(z));
+	chunk.setBlock(getLocalCoord(x), getLocalCoord(y), getLocalCoord(z), t);
 
-	int blockX = x % _blocksPerChunk;
-	int blockY = y % _blocksPerChunk;
-	int blockZ = z % _blocksPerChunk;
+	markEdited(chunk, getLocalCoord(x), getLocalCoord(y), getLocalCoord(z));
 
-	Chunk& chunk = getChunk(chunkX, chunkY, chunkZ);
-	chunk.setBlock(blockX, blockY, blockZ, t);
+	if (!chunk.getPendingLights().empty())
+		_lightUpdateSet.insert(&chunk);
+
+	if (_skyLight)
+		updateSkyColumn(x, y, z, t);
 }
 
 void ChunkManager::setLightSource(int x, int y, int z, int r, int g, int b)
 {
-	int chunkX = x / _blocksPerChunk;
-	int chunkY = y / _blocksPerChunk;
-	int chunkZ = z / _blocksPerChunk;
+	Chunk& chunk = getChunk(getChunkCoord(x), getChunkCoord(y), getChunkCoord(z));
+	chunk.setLightSource(getLocalCoord(x), getLocalCoord(y), getLocalCoord(z), r, g, b);
 
-	int blockX = x % _blocksPerChunk;
-	int blockY = y % _blocksPerChunk;
-	int blockZ = z % _blocksPerChunk;
+	markEdited(chunk, getLocalCoord(x), getLocalCoord(y), getLocalCoord(z));
 
-	Chunk& chunk = getChunk(chunkX, chunkY, chunkZ);
-	chunk.setLightSource(blockX, blockY, blockZ, r, g, b);
+	_lightUpdateSet.insert(&chunk);
 }
 
 void ChunkManager::removeLight(int x, int y, int z)
 {
-	int chunkX = x / _blocksPerChunk;
-	int chunkY = y / _blocksPerChunk;
-	int chunkZ = z / _blocksPerChunk;
+	Chunk* chunk = findChunk(getChunkCoord(x), getChunkCoord(y), getChunkCoord(z));
+
+	if (chunk == nullptr) return;
 
-	int blockX = x % _blocksPerChunk;
-	int blockY = y % _blocksPerChunk;
-	int blockZ = z % _blocksPerChunk;
+	chunk->removeLight(getLocalCoord(x), getLocalCoord(y), getLocalCoord(z));
 
-	Chunk& chunk = getChunk(chunkX, chunkY, chunkZ);
-	chunk.removeLight(blockX, blockY, blockZ);
+	markEdited(*chunk, getLocalCoord(x), getLocalCoord(y), getLocalCoord(z));
+
+	_lightUpdateSet.insert(chunk);
 }
 
 Chunk& ChunkManager::getChunk(int x, int y, int z)
 {
-	if (x < 0) x = 0;
-	if (y < 0) y = 0;
-	if (z < 0) z = 0;
-
-	Chunk& chunk = *(_chunks[(x * _size) + (y * _size * _size) + z]);
+	Chunk* chunk = findChunk(x, y, z);
 
-	if (!chunk.hasLocation())
+	if (chunk == nullptr)
 	{
-		chunk.setLocation(x, y, z);
-		chunk.calculateBounds(_worldTransform);
-		setChunkNeighbors(chunk);
-		chunk.setUpdateCallback(std::bind(&ChunkManager::updateCallback, this, std::placeholders::_1));
+		chunk = createChunk(x, y, z);
+		lightNewChunk(*chunk);
 	}
 
+	return *chunk;
+}
+
+Chunk* ChunkManager::findChunk(int x, int y, int z)
+{
+	ChunkMap::iterator iter = _chunks.find(getChunkKey(x, y, z));
+
+	if (iter == _chunks.end()) return nullptr;
+
+	return iter->second;
+}
+
+Chunk* ChunkManager::createChunk(int x, int y, int z)
+{
+	Chunk* chunk = new Chunk(_blocksPerChunk, _blockSize);
+	chunk->setTileRegions(&_tileRegions);
+	chunk->setMeshMode(_meshMode);
+	chunk->setVertexFormat(_vertexFormat);
+	chunk->setLightModel(_lightModel);
+	chunk->setCaveCulling(_caveCulling);
+	chunk->setQuadIndexBuffer(&_quadIndices);
+
+	chunk->setLocation(x, y, z);
+	chunk->calculateBounds(_worldTransform);
+	chunk->setUpdateCallback(std::bind(&ChunkManager::updateCallback, this, std::placeholders::_1));
+
+	_chunks[getChunkKey(x, y, z)] = chunk;
+
+	linkChunk(*chunk);
+
+	_octree.insert(chunk);
+	_culler.update(chunk);
+	_visibilityDirty = true;
+
 	return chunk;
 }
 
+void ChunkManager::lightNewChunk(Chunk& chunk)
+{
+	int size = _blocksPerChunk;
+
+	Chunk* neighbors[] = { chunk.left, chunk.right, chunk.top, chunk.bottom, chunk.near, chunk.far };
+
+	// let the light of the neighbors flow in through the border blocks facing them
+	bool border = false;
+
+	int face, u, v;
+	for (face = 0; face < 6; ++face)
+	{
+		if (neighbors[face] == nullptr) continue;
+
+		// the coordinate fixed on this face and the two spanning it
+		int axis  = face / 2;
+		int plane = (face == static_cast<int>(BlockFace::LEFT) || face == static_cast<int>(BlockFace::BOTTOM) || face == static_cast<int>(BlockFace::NEAR)) ? 0 : size - 1;
+
+		for (u = 0; u < size; ++u)
+		{
+			for (v = 0; v < size; ++v)
+			{
+				int pos[3];
+				pos[axis]           = plane;
+				pos[(axis + 1) % 3] = u;
+				pos[(axis + 2) % 3] = v;
+
+				chunk.getPendingLights().push_back(chunk.getIndex(pos[0], pos[1], pos[2]));
+			}
+		}
+
+		border = true;
+	}
+
+	if (border)
+		_lightUpdateSet.insert(&chunk);
+
+	if (!_skyLight) return;
+
+	// the blocks of lit columns above their height are open to the sky
+	Vector3 loc = chunk.getLocation();
+
+	int x0 = (int)loc.x * size;
+	int y0 = (int)loc.y * size;
+	int z0 = (int)loc.z * size;
+
+	int x, y, z;
+	for (x = 0; x < size; ++x)
+	{
+		for (z = 0; z < size; ++z)
+		{
+			int gx = x0 + x;
+			int gz = z0 + z;
+
+			if (gx < 0 || gx >= _blockX || gz < 0 || gz >= _blockZ) continue;
+
+			int height = _skyHeights[gx + gz * _blockX];
+
+			// columns still queued are lit when they are reached
+			if (height < 0) continue;
+
+			for (y = 0; y < size; ++y)
+			{
+				int gy = y0 + y;
+
+				if (gy >= height && gy < _blockY && chunk.getBlockType(chunk.getIndex(x, y, z)) == 0)
+					_lightEngine.setSkyLight(chunk, x, y, z);
+			}
+		}
+	}
+}
+
+void ChunkManager::updateSkyHeights(Chunk& chunk)
+{
+	if (!_skyLight) return;
+
+	int size = _blocksPerChunk;
+
+	Vector3 loc = chunk.getLocation();
+
+	int x0 = (int)loc.x * size;
+	int y0 = (int)loc.y * size;
+	int z0 = (int)loc.z * size;
+
+	int x, y, z;
+	for (x = 0; x < size; ++x)
+	{
+		for (z = 0; z < size; ++z)
+		{
+			// the top solid block of the column within the chunk
+			int t = 0;
+
+			for (y = size - 1; y >= 0; --y)
+			{
+				t = chunk.getBlockType(chunk.getIndex(x, y, z));
+
+				if (t != 0) break;
+			}
+
+			// placed as if by an edit, so a column it closes is dark below it, in this chunk and the ones below
+			if (t != 0)
+				updateSkyColumn(x0 + x, y0 + y, z0 + z, t);
+		}
+	}
+}
+
+void ChunkManager::unloadChunk(int x, int y, int z)
+{
+	Chunk* chunk = findChunk(x, y, z);
+
+	if (chunk != nullptr)
+		_chunkUnloadSet.insert(chunk);
+}
+
+void ChunkManager::unloadChunks()
+{
+	if (_chunkUnloadSet.empty()) return;
+
+	// one pass over the render list for the whole batch
+	ChunkList::iterator last = std::remove_if(_renderList.begin(), _renderList.end(), [this](Chunk* chunk)
+	{
+		return _chunkUnloadSet.find(chunk) != _chunkUnloadSet.end();
+	});
+
+	_renderList.erase(last, _renderList.end());
+
+	ChunkSet::iterator iter;
+	for (iter = _chunkUnloadSet.begin(); iter != _chunkUnloadSet.end(); ++iter)
+	{
+		Chunk* chunk = (*iter);
+
+		Vector3 loc = chunk->getLocation();
+
+		if (_chunkUnloadCallback)
+			_chunkUnloadCallback(*chunk);
+
+		// the neighbors' faces toward the chunk were culled against its blocks and are open now
+		Chunk* neighbors[] = { chunk->left, chunk->right, chunk->top, chunk->bottom, chunk->near, chunk->far };
+
+		int i;
+		for (i = 0; i < 6; ++i)
+		{
+			if (neighbors[i] != nullptr && neighbors[i]->isSetup())
+				neighbors[i]->markForUpdate();
+		}
+
+		unlinkChunk(*chunk);
+		_chunks.erase(getChunkKey((int)loc.x, (int)loc.y, (int)loc.z));
+
+		_octree.remove(chunk);
+		_culler.remove(chunk);
+		_visibilityDirty = true;
+
+		_chunkRebuildSet.erase(chunk);
+		_lightUpdateSet.erase(chunk);
+		_editFrames.erase(chunk);
+
+		// frees the block and light data along with the GL buffers
+		delete chunk;
+	}
+
+	_evictions += (unsigned int)_chunkUnloadSet.size();
+	_chunkUnloadSet.clear();
+}
+
+void ChunkManager::setViewRadius(int loadRadius, int unloadRadius)
+{
+	_loadRadius   = loadRadius;
+	_unloadRadius = std::max(unloadRadius, loadRadius);
+
+	// offsets within the load radius sorted by distance, so loads are queued nearest first
+	_streamOffsets.clear();
+
+	int r2 = loadRadius * loadRadius;
+
+	int x, y, z;
+	for (x = -loadRadius; x <= loadRadius; ++x)
+		for (y = -loadRadius; y <= loadRadius; ++y)
+			for (z = -loadRadius; z <= loadRadius; ++z)
+			{
+				if (x * x + y * y + z * z > r2) continue;
+
+				ChunkCoord offset = { x, y, z };
+				_streamOffsets.push_back(offset);
+			}
+
+	std::stable_sort(_streamOffsets.begin(), _streamOffsets.end(), [](const ChunkCoord& a, const ChunkCoord& b)
+	{
+		return (a.x * a.x + a.y * a.y + a.z * a.z) < (b.x * b.x + b.y * b.y + b.z * b.z);
+	});
+
+	// queue again around the current position
+	_streamCenterValid = false;
+}
+
+void ChunkManager::setViewPosition(const Vector3& position)
+{
+	_viewPosition = position;
+}
+
+void ChunkManager::setChunkGenerator(ChunkCallback generator)
+{
+	_chunkGenerator = generator;
+	_streamCenterValid = false;
+}
+
+void ChunkManager::setChunkUnloadCallback(ChunkCallback callback)
+{
+	_chunkUnloadCallback = callback;
+}
+
+void ChunkManager::setLoadsPerFrame(int loads)
+{
+	_loadsPerFrame = loads;
+}
+
+unsigned int ChunkManager::getQueuedLoadCount() const
+{
+	return (unsigned int)(_loadQueue.size() - _nextLoad);
+}
+
+float ChunkManager::getEvictionsPerSecond() const
+{
+	return _evictionsPerSecond;
+}
+
+void ChunkManager::updateStreaming()
+{
+	_evictionTime += _evictionTimer.getElapsed();
+
+	if (_evictionTime >= 1.0f)
+	{
+		_evictionsPerSecond = (float)_evictions / _evictionTime;
+		_evictions    = 0;
+		_evictionTime = 0;
+	}
+
+	if (_loadRadius <= 0) return;
+
+	ChunkCoord center = getViewChunk();
+
+	bool moved = !_streamCenterValid || center.x != _streamCenter.x || center.y != _streamCenter.y || center.z != _streamCenter.z;
+
+	if (moved)
+		queueStreaming(center);
+
+	int loaded = 0;
+	while (_nextLoad < _loadQueue.size() && loaded < _loadsPerFrame)
+	{
+		ChunkCoord& coord = _loadQueue[_nextLoad++];
+
+		// written to since it was queued
+		if (findChunk(coord.x, coord.y, coord.z) != nullptr) continue;
+
+		Chunk* chunk = createChunk(coord.x, coord.y, coord.z);
+		_chunkGenerator(*chunk);
+		updateSkyHeights(*chunk);
+		lightNewChunk(*chunk);
+
+		// meshed without waiting for the view to move
+		_chunkRebuildSet.insert(chunk);
+
+		++loaded;
+	}
+
+	if (_nextLoad == _loadQueue.size())
+	{
+		_loadQueue.clear();
+		_nextLoad = 0;
+	}
+}
+
+ChunkManager::ChunkCoord ChunkManager::getViewChunk()
+{
+	int x, y, z;
+	getGridBlock(_viewPosition, x, y, z);
+
+	ChunkCoord center = { getChunkCoord(x), getChunkCoord(y), getChunkCoord(z) };
+
+	return center;
+}
+
+void ChunkManager::getGridBlock(const Vector3& position, int& x, int& y, int& z)
+{
+	Vector3 grid = getGridPosition(position);
+
+	float blockRenderSize = _blockSize * 2;
+
+	// blocks are centered on their coordinates
+	x = (int)std::floor((grid.x + _blockSize) / blockRenderSize);
+	y = (int)std::floor((grid.y + _blockSize) / blockRenderSize);
+	z = (int)std::floor((grid.z + _blockSize) / blockRenderSize);
+}
+
+Vector3 ChunkManager::getGridPosition(const Vector3& position)
+{
+	// the world transform is affine. Its images of the origin and the axes give the linear part, which is
+	// inverted with the cross products of its columns
+	Vector4 o = _worldTransform * Vector4(0, 0, 0, 1);
+	Vector4 x = _worldTransform * Vector4(1, 0, 0, 1);
+	Vector4 y = _worldTransform * Vector4(0, 1, 0, 1);
+	Vector4 z = _worldTransform * Vector4(0, 0, 1, 1);
+
+	Vector3 origin(o.x, o.y, o.z);
+
+	Vector3 ex = Vector3(x.x, x.y, x.z) - origin;
+	Vector3 ey = Vector3(y.x, y.y, y.z) - origin;
+	Vector3 ez = Vector3(z.x, z.y, z.z) - origin;
+
+	Vector3 yz = ey;
+	yz.cross(ez);
+
+	Vector3 zx = ez;
+	zx.cross(ex);
+
+	Vector3 xy = ex;
+	xy.cross(ey);
+
+	float det = ex.dot(yz);
+
+	Vector3 d = position - origin;
+
+	// a transform scaled to nothing has no inverse
+	if (det == 0) return d;
+
+	return Vector3(d.dot(yz) / det, d.dot(zx) / det, d.dot(xy) / det);
+}
+
+void ChunkManager::queueStreaming(const ChunkCoord& center)
+{
+	_streamCenter      = center;
+	_streamCenterValid = true;
+
+	_loadQueue.clear();
+	_nextLoad = 0;
+
+	if (_chunkGenerator)
+	{
+		for (const ChunkCoord& offset : _streamOffsets)
+		{
+			ChunkCoord coord = { center.x + offset.x, center.y + offset.y, center.z + offset.z };
+
+			if (findChunk(coord.x, coord.y, coord.z) == nullptr)
+				_loadQueue.push_back(coord);
+		}
+	}
+
+	// without a generator to load them again or a callback to keep them, evicted chunks would lose the
+	// blocks written to them
+	if (!_chunkGenerator && !_chunkUnloadCallback) return;
+
+	int r2 = _unloadRadius * _unloadRadius;
+
+	ChunkMap::iterator iter;
+	for (iter = _chunks.begin(); iter != _chunks.end(); ++iter)
+	{
+		Vector3 loc = iter->second->getLocation();
+
+		int dx = (int)loc.x - center.x;
+		int dy = (int)loc.y - center.y;
+		int dz = (int)loc.z - center.z;
+
+		if (dx * dx + dy * dy + dz * dz > r2)
+			_chunkUnloadSet.insert(iter->second);
+	}
+}
+
+unsigned int ChunkManager::getChunkCount() const
+{
+	return (unsigned int)_chunks.size();
+}
+
+int ChunkManager::getChunkCoord(int b) const
+{
+	// round down so negative blocks land in the chunk below zero
+	return (b >= 0) ? b / _blocksPerChunk : -((-b - 1) / _blocksPerChunk) - 1;
+}
+
+int ChunkManager::getLocalCoord(int b) const
+{
+	return b - getChunkCoord(b) * _blocksPerChunk;
+}
+
 void ChunkManager::rebuildChunks()
 {
 	// nothing to rebuild
 	if (_chunkRebuildSet.size() == 0) return;
 
-	int rebuiltCount = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-	ChunkList rebuilt;
+	util::ThreadPool& pool = VoxelEngine::getEngine()->getThreadPool();
+
+	// order the waiting chunks, the latest edits first, then the chunks in view, then the nearest
+	std::vector<RebuildCandidate> candidates;
+	candidates.reserve(_chunkRebuildSet.size());
 
 	ChunkSet::iterator iter;
-	for (iter = _chunkRebuildSet.begin(); rebuiltCount < _rebuildsPerFrame && iter != _chunkRebuildSet.end(); ++iter)
+	for (iter = _chunkRebuildSet.begin(); iter != _chunkRebuildSet.end(); ++iter)
 	{
-		// build the chunk
 		Chunk* chunk = (*iter);
-		chunk->build();
 
-		// set it to be removed later
-		rebuilt.push_back(chunk);
+		std::unordered_map<Chunk*, unsigned int>::iterator edit = _editFrames.find(chunk);
 
-		// add to the render list
-		_chunkRenderSet.insert(chunk);
+		Vector3& center = chunk->getBounds().center;
 
-		//
-		rebuiltCount++;
+		float dx = center.x - _viewPosition.x;
+		float dy = center.y - _viewPosition.y;
+		float dz = center.z - _viewPosition.z;
+
+		RebuildCandidate candidate;
+		candidate.chunk     = chunk;
+		candidate.editFrame = (edit != _editFrames.end()) ? edit->second : 0;
+		candidate.visible   = chunk->isVisible();
+		candidate.distance  = dx * dx + dy * dy + dz * dz;
+
+		candidates.push_back(candidate);
 	}
 
-	// remove rebuilt chunks
-	ChunkList::iterator rebuiltIter;
-	for (rebuiltIter = rebuilt.begin(); rebuiltIter != rebuilt.end(); ++rebuiltIter)
+	std::sort(candidates.begin(), candidates.end(), [](const RebuildCandidate& a, const RebuildCandidate& b)
 	{
-		_chunkRebuildSet.erase(*rebuiltIter);
+		if (a.editFrame != b.editFrame) return a.editFrame > b.editFrame;
+		if (a.visible != b.visible)     return a.visible;
+
+		return a.distance < b.distance;
+	});
+
+	// a chunk per meshing thread at a time, until the frame's budget is spent. At least one batch is built
+	// every frame so the queue always drains
+	size_t batchSize = pool.getThreadCount() + 1;
+	size_t next = 0;
+
+	ChunkList rebuilt;
+	long long elapsed;
+
+	do
+	{
+		rebuilt.clear();
+
+		while (rebuilt.size() < batchSize && next < candidates.size())
+			rebuilt.push_back(candidates[next++].chunk);
+
+		ChunkList::iterator rebuiltIter;
+
+		// copy the neighbor borders, after this the workers only read their own chunk
+		for (rebuiltIter = rebuilt.begin(); rebuiltIter != rebuilt.end(); ++rebuiltIter)
+		{
+			(*rebuiltIter)->takeSnapshot();
+		}
+
+		// generate the vertex data in parallel
+		for (rebuiltIter = rebuilt.begin(); rebuiltIter != rebuilt.end(); ++rebuiltIter)
+		{
+			Chunk* chunk = (*rebuiltIter);
+			pool.submit([chunk]{ chunk->generateMesh(); });
+		}
+
+		pool.wait();
+
+		// upload on the main thread and box the new geometry, chunks in the render list are drawn from the next frame
+		for (rebuiltIter = rebuilt.begin(); rebuiltIter != rebuilt.end(); ++rebuiltIter)
+		{
+			Chunk* chunk = (*rebuiltIter);
+			chunk->upload();
+
+			chunk->calculateBounds(_worldTransform);
+			_octree.update(chunk);
+			_culler.update(chunk);
+			_visibilityDirty = true;
+
+			_chunkRebuildSet.erase(chunk);
+			_editFrames.erase(chunk);
+		}
+
+		elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
 	}
+	while (next < candidates.size() && elapsed < _rebuildBudget);
+}
+
+void ChunkManager::setRebuildBudget(int microseconds)
+{
+	_rebuildBudget = microseconds;
+}
+
+void ChunkManager::enableSkyLight()
+{
+	if (_skyLight) return;
+
+	_skyLight = true;
+
+	int columns = _blockX * _blockZ;
+
+	_skyHeights.assign(columns, -1);
+	_skyColumns.resize(columns);
+
+	int i;
+	for (i = 0; i < columns; ++i)
+		_skyColumns[i] = i;
+
+	_nextSkyColumn = 0;
+}
+
+void ChunkManager::setSkyColumnsPerFrame(int columns)
+{
+	_skyColumnsPerFrame = columns;
+}
+
+void ChunkManager::updateLighting()
+{
+	if (_skyLight)
+		updateSkyLight();
+
+	// block light only stays within the neighbors of its chunk when a chunk is at least as wide as the light reaches
+	if (_parallelLighting && _blocksPerChunk >= LIGHT_RANGE)
+	{
+		// sky light removal follows columns down through any number of chunks, so it is always spread serially
+		_lightEngine.spread();
+
+		spreadLightGroups();
+	}
+	else
+	{
+		// queue the light changes of every edited chunk so they spread in one fill
+		ChunkSet::iterator iter;
+		for (iter = _lightUpdateSet.begin(); iter != _lightUpdateSet.end(); ++iter)
+		{
+			_lightEngine.addChunk(**iter);
+		}
+
+		_lightEngine.spread();
+	}
+
+	_lightUpdateSet.clear();
+
+	// each chunk whose light changed is remeshed once, however many edits reached it
+	markLightChanged(_lightEngine);
+
+	std::vector<LightEngine>::iterator workerIter;
+	for (workerIter = _lightWorkers.begin(); workerIter != _lightWorkers.end(); ++workerIter)
+	{
+		markLightChanged(*workerIter);
+	}
+}
+
+void ChunkManager::spreadLightGroups()
+{
+	if (_lightUpdateSet.empty()) return;
+
+	util::ThreadPool& pool = VoxelEngine::getEngine()->getThreadPool();
+
+	unsigned int workers = pool.getThreadCount() + 1;
+
+	if (_lightWorkers.size() < workers)
+		_lightWorkers.resize(workers, LightEngine(_lightModel));
+
+	ChunkList chunks(_lightUpdateSet.begin(), _lightUpdateSet.end());
+
+	LightEngine::spreadGroups(chunks, _lightWorkers, pool);
+}
+
+void ChunkManager::markLightChanged(LightEngine& engine)
+{
+	ChunkList& changed = engine.getChangedChunks();
+
+	ChunkList::iterator changedIter;
+	for (changedIter = changed.begin(); changedIter != changed.end(); ++changedIter)
+	{
+		(*changedIter)->setLightChanged(false);
+		(*changedIter)->markForUpdate();
+
+		// light spread by this frame's edits is rebuilt along with the edited chunks
+		if (_lastEditFrame == _frame)
+			_editFrames[*changedIter] = _frame;
+	}
+
+	changed.clear();
+}
+
+void ChunkManager::markEdited(Chunk& chunk, int x, int y, int z)
+{
+	_editFrames[&chunk] = _frame;
+	_lastEditFrame = _frame;
+
+	// neighbors remeshed because the edit is on their border, including the edge and corner neighbors whose
+	// ambient occlusion samples the block
+	int size = _blocksPerChunk;
+
+	// chunk steps toward the neighbors the block touches on each axis, 0 when it is inside
+	int steps[3] = {
+		(x == 0) ? -1 : (x == size - 1) ? 1 : 0,
+		(y == 0) ? -1 : (y == size - 1) ? 1 : 0,
+		(z == 0) ? -1 : (z == size - 1) ? 1 : 0
+	};
+
+	if (steps[0] == 0 && steps[1] == 0 && steps[2] == 0) return;
+
+	Vector3 loc = chunk.getLocation();
+
+	// every combination of the steps, each axis either stepping or staying
+	int i;
+	for (i = 1; i < 8; ++i)
+	{
+		int dx = (i & 1) ? steps[0] : 0;
+		int dy = (i & 2) ? steps[1] : 0;
+		int dz = (i & 4) ? steps[2] : 0;
+
+		// combinations stepping along an axis the block isn't on the border of repeat another one
+		if (((i & 1) && dx == 0) || ((i & 2) && dy == 0) || ((i & 4) && dz == 0)) continue;
+
+		Chunk* neighbor = findChunk((int)loc.x + dx, (int)loc.y + dy, (int)loc.z + dz);
+
+		if (neighbor != nullptr)
+			_editFrames[neighbor] = _frame;
+	}
+}
+
+void ChunkManager::setParallelLighting(bool parallel)
+{
+	_parallelLighting = parallel;
+}
+
+void ChunkManager::updateSkyLight()
+{
+	int lit = 0;
+	while (_nextSkyColumn < _skyColumns.size() && lit < _skyColumnsPerFrame)
+	{
+		lightSkyColumn(_skyColumns[_nextSkyColumn++]);
+		++lit;
+	}
+
+	if (_nextSkyColumn == _skyColumns.size())
+	{
+		_skyColumns.clear();
+		_skyColumns.shrink_to_fit();
+		_nextSkyColumn = 0;
+	}
+}
+
+void ChunkManager::lightSkyColumn(int column)
+{
+	int x = column % _blockX;
+	int z = column / _blockX;
+
+	// find the highest solid block
+	int y;
+	for (y = _blockY - 1; y >= 0; --y)
+	{
+		if (getBlockType(x, y, z) != 0) break;
+	}
+
+	int height = y + 1;
+
+	// everything above it is open to the sky
+	for (y = _blockY - 1; y >= height; --y)
+	{
+		Chunk* chunk = findChunk(getChunkCoord(x), getChunkCoord(y), getChunkCoord(z));
+
+		// empty chunks are never meshed and have no faces to light
+		if (chunk != nullptr)
+			_lightEngine.setSkyLight(*chunk, getLocalCoord(x), getLocalCoord(y), getLocalCoord(z));
+	}
+
+	_skyHeights[column] = height;
+}
+
+void ChunkManager::updateSkyColumn(int x, int y, int z, int t)
+{
+	// sky light covers the grid dimensions
+	if (x < 0 || x >= _blockX || y < 0 || y >= _blockY || z < 0 || z >= _blockZ) return;
+
+	int column = x + z * _blockX;
+	int height = _skyHeights[column];
+
+	// the column gets its light when it is reached in the queue
+	if (height < 0) return;
+
+	int yy;
+
+	if (t != 0)
+	{
+		// the block and, if it closes the column, everything below it lose their light from above
+		int bottom = (y >= height) ? height : y;
+
+		for (yy = y; yy >= bottom; --yy)
+		{
+			Chunk* chunk = findChunk(getChunkCoord(x), getChunkCoord(yy), getChunkCoord(z));
+
+			if (chunk != nullptr)
+				_lightEngine.removeSkyLight(*chunk, getLocalCoord(x), getLocalCoord(yy), getLocalCoord(z));
+		}
+
+		if (y >= height)
+			_skyHeights[column] = y + 1;
+	}
+	else if (y == height - 1)
+	{
+		// the top block of the column was removed, open the column down to the next solid block
+		int newHeight = y;
+		while (newHeight > 0 && getBlockType(x, newHeight - 1, z) == 0) --newHeight;
+
+		for (yy = y; yy >= newHeight; --yy)
+		{
+			Chunk* chunk = findChunk(getChunkCoord(x), getChunkCoord(yy), getChunkCoord(z));
+
+			if (chunk != nullptr)
+				_lightEngine.setSkyLight(*chunk, getLocalCoord(x), getLocalCoord(yy), getLocalCoord(z));
+		}
+
+		_skyHeights[column] = newHeight;
+	}
+}
+
+uint8_t ChunkManager::getBlockType(int x, int y, int z)
+{
+	Chunk* chunk = findChunk(getChunkCoord(x), getChunkCoord(y), getChunkCoord(z));
+
+	if (chunk == nullptr) return 0;
+
+	return chunk->getBlockType(chunk->getIndex(getLocalCoord(x), getLocalCoord(y), getLocalCoord(z)));
 }
 
 void ChunkManager::updateCallback(Chunk* chunk)
@@ -294,6 +1248,7 @@ sgl::Matrix4& ChunkManager::getWorldTransform()
 void ChunkManager::setAtlasName(const std::string& name)
 {
 	_atlasName = name;
+	_tileRegionsGeneration = 0;
 }
 
 std::string ChunkManager::getAtlasName()
@@ -306,59 +1261,126 @@ void ChunkManager::setRenderDebug(bool d)
 	_renderDebug = d;
 }
 
+void ChunkManager::setMeshMode(Chunk::MeshMode mode)
+{
+	_meshMode = mode;
+
+	for (auto& entry : _chunks)
+	{
+		entry.second->setMeshMode(mode);
+		entry.second->markForUpdate();
+	}
+}
+
+Chunk::MeshMode ChunkManager::getMeshMode() const
+{
+	return _meshMode;
+}
+
+void ChunkManager::setVertexFormat(VertexFormat format)
+{
+	_vertexFormat = format;
+
+	for (auto& entry : _chunks)
+	{
+		entry.second->setVertexFormat(format);
+		entry.second->markForUpdate();
+	}
+}
+
+VertexFormat ChunkManager::getVertexFormat() const
+{
+	return _vertexFormat;
+}
+
+unsigned int ChunkManager::getMeshSize()
+{
+	unsigned int size = 0;
+
+	for (auto& entry : _chunks)
+		size += entry.second->getMeshSize();
+
+	return size;
+}
+
 bool ChunkManager::boundingVolumeOutOfDate()
 {
 	return _updateBoundingVolume;
 }
 
-void ChunkManager::allocateChunks(int chunkSize, float blockSize)
+void ChunkManager::updateTileRegions()
 {
-	int xSize = _blockX / chunkSize;
-	int ySize = _blockY / chunkSize;
-	int zSize = _blockZ / chunkSize;
+	TextureAtlas& atlas = VoxelEngine::getEngine()->getResources().getTextureManager().getAtlas(_atlasName);
 
-	if (xSize >= ySize && xSize >= zSize) _size = xSize;
-	if (ySize >= xSize && ySize >= zSize) _size = ySize;
-	if (zSize >= ySize && zSize >= xSize) _size = zSize;
+	if (atlas.getGeneration() == _tileRegionsGeneration) return;
 
-	int chunksToAllocate = _size * _size * _size;
+	bool reloaded = !_tileRegions.empty();
 
-	int i;
-	for (i = 0; i < chunksToAllocate; ++i)
-	{
-		Chunk* chunk = new Chunk(chunkSize, blockSize);
-		chunk->setAtlasName(_atlasName);
+	_tileRegions.clear();
+
+	unsigned int i;
+	for (i = 0; i < atlas.getRegionCount(); ++i)
+		_tileRegions.push_back(atlas.getTileRegion(i));
+
+	_tileRegionsGeneration = atlas.getGeneration();
+
+	_tileRegionBuffer.setRegions(_tileRegions);
 
-		_chunks.push_back(chunk);
+	// float vertices have their regions baked in, rebuild the chunks that were meshed with the old table
+	if (reloaded && _vertexFormat == VertexFormat::FLOAT)
+	{
+		for (auto& entry : _chunks)
+		{
+			if (entry.second->isSetup())
+				entry.second->markForUpdate();
+		}
 	}
 }
 
-void ChunkManager::setChunkNeighbors(Chunk& chunk)
+void ChunkManager::linkChunk(Chunk& chunk)
 {
 	Vector3 loc = chunk.getLocation();
 	int x = (int)loc.x;
 	int y = (int)loc.y;
 	int z = (int)loc.z;
 
-	if (x - 1 >= 0)
-		chunk.left   = &getChunk(x - 1, y, z);
-	if (x + 1 < _size)
-		chunk.right  = &getChunk(x + 1, y, z);
-	if (y + 1 < _size)
-		chunk.top    = &getChunk(x, y + 1, z);
-	if (y - 1 >= 0)
-		chunk.bottom = &getChunk(x, y - 1, z);
-	if (z - 1 >= 0)
-		chunk.near   = &getChunk(x, y, z - 1);
-	if (z + 1 < _size)
-		chunk.far    = &getChunk(x, y, z + 1);
+	chunk.left   = findChunk(x - 1, y, z);
+	chunk.right  = findChunk(x + 1, y, z);
+	chunk.top    = findChunk(x, y + 1, z);
+	chunk.bottom = findChunk(x, y - 1, z);
+	chunk.near   = findChunk(x, y, z - 1);
+	chunk.far    = findChunk(x, y, z + 1);
+
+	if (chunk.left   != nullptr) chunk.left->right  = &chunk;
+	if (chunk.right  != nullptr) chunk.right->left  = &chunk;
+	if (chunk.top    != nullptr) chunk.top->bottom  = &chunk;
+	if (chunk.bottom != nullptr) chunk.bottom->top  = &chunk;
+	if (chunk.near   != nullptr) chunk.near->far    = &chunk;
+	if (chunk.far    != nullptr) chunk.far->near    = &chunk;
+}
+
+void ChunkManager::unlinkChunk(Chunk& chunk)
+{
+	if (chunk.left   != nullptr) chunk.left->right  = nullptr;
+	if (chunk.right  != nullptr) chunk.right->left  = nullptr;
+	if (chunk.top    != nullptr) chunk.top->bottom  = nullptr;
+	if (chunk.bottom != nullptr) chunk.bottom->top  = nullptr;
+	if (chunk.near   != nullptr) chunk.near->far    = nullptr;
+	if (chunk.far    != nullptr) chunk.far->near    = nullptr;
+
+	chunk.left   = nullptr;
+	chunk.right  = nullptr;
+	chunk.top    = nullptr;
+	chunk.bottom = nullptr;
+	chunk.near   = nullptr;
+	chunk.far    = nullptr;
 }
 
 ChunkManager::~ChunkManager()
 {
-	ChunkList::iterator iter;
+	ChunkMap::iterator iter;
 	for (iter = _chunks.begin(); iter != _chunks.end(); ++iter)
 	{
-		delete *iter;
+		delete iter->second;
 	}
 }
@@ -3,19 +3,45 @@
 #define CHUNKMANAGER_H
 
 #include "Chunk.h"
+#include "LightEngine.h"
+#include "ChunkOctree.h"
+#include "ChunkCuller.h"
+#include "OcclusionBuffer.h"
 #include "FPSCamera.h"
+#include "Timer.h"
 
 #include <SGL/Math/Matrix4.h>
 
 #include <vector>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <string>
+#include <functional>
+#include <cstdint>
 
 namespace engine
 {
 	typedef std::vector<Chunk*> ChunkList;
 	typedef std::set<Chunk*>    ChunkSet;
 
+	// resident chunks keyed by their packed chunk coordinates
+	typedef std::unordered_map<uint64_t, Chunk*> ChunkMap;
+
+	// fills the blocks of a chunk entering the view radius, or writes back a chunk leaving it
+	typedef std::function<void(Chunk&)> ChunkCallback;
+
+	/**
+		Sparse grid of chunks.
+
+		Chunks are created the first time a block or light is written in them and are addressed by chunk
+		coordinate through a hash map, so the grid has no fixed extent and coordinates may be negative. Space
+		without a chunk reads as air. The grid dimensions passed at construction bound the sky light and are the
+		area scripts generate.
+
+		With a view radius set, chunks around the view position are generated nearest first and chunks beyond
+		the unload radius are evicted
+	*/
 	class ChunkManager
 	{
 	public:
@@ -23,11 +49,20 @@ namespace engine
 		/**
 			(x, y, z) - grid dimensions in blocks
 
-			chunkSize - number of blocks per chunk
+			chunkSize - number of blocks per chunk axis, 1 to Chunk::MAX_SIZE
 			blockSize - half the render size of the block
 		*/
 		ChunkManager(int x, int y, int z, int blocksPerChunk, float blockSize, const char *atlasName);
 
+		/**
+			(x, y, z) - grid dimensions in blocks
+
+			chunkSize  - number of blocks per chunk axis, 1 to Chunk::MAX_SIZE
+			blockSize  - half the render size of the block
+			lightModel - how the chunks store light, per face of every block or per air voxel
+		*/
+		ChunkManager(int x, int y, int z, int blocksPerChunk, float blockSize, const char *atlasName, LightModel lightModel);
+
 		/**
 			(x, y, z) - grid dimensions in blocks
 		*/
@@ -41,9 +76,60 @@ namespace engine
 		void update();
 
 		/**
-			get the list of chunks in visible range of the camera frustum
+			get the list of chunks in visible range of the camera frustum. The frustum is kept to cull the grid
+			again when chunks are loaded or unloaded.
+
+			The octree is only walked when the view has moved or turned past the visibility guard since the
+			last walk. In between, only the chunks the walk found near the frustum are tested again
+		*/
+		void updateVisiblityList(ViewFrustum& frustum);
+
+		/**
+			Set how far in world units and how many radians the view can move and turn before the octree is
+			walked again. Larger guards walk the octree less often but test more chunks every update
+		*/
+		void setVisibilityGuard(float distance, float angle);
+
+		/**
+			@return the number of octree walks since the grid was created
+		*/
+		unsigned int getFullCullCount() const;
+
+		/**
+			@return the number of octree nodes tested against the frustum by the last cull
+		*/
+		unsigned int getNodesTested() const;
+
+		/**
+			@return the number of chunks accepted by the last cull. Chunks without geometry are never accepted
+		*/
+		unsigned int getVisibleChunkCount() const;
+
+		/**
+			Cull the chunks that can't be seen through air from the chunk of the view position. Chunks are
+			walked outwards from the view, only crossing a chunk between sides joined by air and never turning
+			back along an axis. The walk starts from the view position taken through the inverse of the world
+			transform, so it follows a translated, rotated or scaled grid. Underground this leaves out the
+			surface. Disabled by default
+		*/
+		void setCaveCulling(bool enabled);
+
+		/**
+			Cull the chunks hidden behind the solid sides of the chunks around the view, drawn into a low
+			resolution depth buffer on the CPU. Disabled by default
+		*/
+		void setOcclusionCulling(bool enabled);
+
+		/**
+			@return the number of chunks in the frustum the last cull found hidden. With getVisibleChunkCount
+			this gives the share of chunks culled by occlusion
+		*/
+		unsigned int getOccludedChunkCount() const;
+
+		/**
+			@return the time in microseconds the last occlusion pass took
 		*/
-		void updateVisiblityList(sgl::Frustum& frustum);
+		float getOcclusionTime() const;
 
 		/**
 			translate this grid
@@ -85,12 +171,16 @@ namespace engine
 		void removeLight(int x, int y, int z);
 
 		/**
-			Get the block from the specified position
+			Get the block containing the specified world position, through the world transform
 		*/
 		Block getBlockFromWorldPosition(const sgl::Vector3& position);
 
-		Chunk& getChunkFromWorldPosition(const sgl::Vector3& position);
-		Chunk& getChunkFromWorldPosition(float x, float y, float z);
+		/**
+			Get the chunk containing the specified world position, through the world transform. nullptr if no
+			chunk is resident there
+		*/
+		Chunk* getChunkFromWorldPosition(const sgl::Vector3& position);
+		Chunk* getChunkFromWorldPosition(float x, float y, float z);
 		
 		/**
 		*/
@@ -107,14 +197,108 @@ namespace engine
 
 		void setRenderDebug(bool d);
 
+		/**
+			Set the method used to mesh the chunks of this grid. Chunks are rebuilt with the new method
+		*/
+		void setMeshMode(Chunk::MeshMode mode);
+		Chunk::MeshMode getMeshMode() const;
+
+		/**
+			Set the vertex layout of the chunk meshes. Chunks are rebuilt with the new layout
+		*/
+		void setVertexFormat(VertexFormat format);
+		VertexFormat getVertexFormat() const;
+
+		/**
+			@return the total size in bytes of the vertex data of all chunks
+		*/
+		unsigned int getMeshSize();
+
+		/**
+			Set the time in microseconds spent rebuilding chunks per frame. Chunks are rebuilt in order of edit
+			recency, visibility and distance to the view, a batch per meshing thread at a time
+		*/
+		void setRebuildBudget(int microseconds);
+
+		/**
+			Light the grid from above. Columns are lit over several frames, later edits update the sky light
+			of their column as they happen
+		*/
+		void enableSkyLight();
+
+		/**
+			Set the number of columns given sky light per frame while the grid is being lit
+		*/
+		void setSkyColumnsPerFrame(int columns);
+
+		/**
+			Spread the block light of chunks far enough apart on the meshing threads. The light is the same as
+			when spread serially, only the order blocks are reached in differs. Enabled by default
+		*/
+		void setParallelLighting(bool parallel);
+
+		/**
+			Queue the chunk at chunk coordinate (x, y, z) for unloading. Its block, light and mesh data are freed
+			on the next update
+		*/
+		void unloadChunk(int x, int y, int z);
+
+		/**
+			@return the number of resident chunks
+		*/
+		unsigned int getChunkCount() const;
+
+		/**
+			Stream chunks around the view position. Chunks within loadRadius chunks are generated and chunks past
+			unloadRadius are evicted, unloadRadius is kept above loadRadius so chunks on the edge don't load and
+			unload as the view moves back and forth. A load radius of 0 disables streaming. Nothing is evicted
+			unless a chunk generator or an unload callback is set
+		*/
+		void setViewRadius(int loadRadius, int unloadRadius);
+
+		/**
+			Set the world position streaming is centered on, usually the camera position
+		*/
+		void setViewPosition(const sgl::Vector3& position);
+
+		/**
+			Set the callback filling the blocks of chunks loaded by streaming. Without one nothing is loaded,
+			chunks are only created by writes
+		*/
+		void setChunkGenerator(ChunkCallback generator);
+
+		/**
+			Set the callback called with each chunk before it is evicted, to persist it
+		*/
+		void setChunkUnloadCallback(ChunkCallback callback);
+
+		/**
+			Set the number of chunks generated per frame while streaming
+		*/
+		void setLoadsPerFrame(int loads);
+
+		/**
+			@return the number of chunks waiting to be generated
+		*/
+		unsigned int getQueuedLoadCount() const;
+
+		/**
+			@return the number of chunks evicted per second, averaged over the last second
+		*/
+		float getEvictionsPerSecond() const;
+
 		bool boundingVolumeOutOfDate();
 
 	private:
 
-		ChunkList _chunks;
-		ChunkSet  _chunkRenderSet;
-		ChunkSet  _chunkVisibleSet;
+		ChunkMap  _chunks;
+		// chunks in the view frustum, front to back from the view position
+		ChunkList _renderList;
 		ChunkSet  _chunkRebuildSet;
+		// chunks to free on the next update
+		ChunkSet  _chunkUnloadSet;
+		// chunks with light sources or edits waiting for the light engine
+		ChunkSet  _lightUpdateSet;
 
 		int _blockX;           // number of block in the x direction
 		int _blockY;           // number of block in the y direction
@@ -123,27 +307,183 @@ namespace engine
 		int   _blocksPerChunk; // number of blocks in one dimesnsion of the chunk
 		float _blockSize;      // half size of block
 
-		int _size;
+		int _rebuildBudget;    // microseconds spent rebuilding chunks per frame
 
-		int _rebuildsPerFrame;
+		// number of the current update, edits made before an update belong to it
+		unsigned int _frame;
+		// frame of the last edit
+		unsigned int _lastEditFrame;
+		// frame of the latest edit touching each chunk waiting for a rebuild
+		std::unordered_map<Chunk*, unsigned int> _editFrames;
+
+		struct RebuildCandidate
+		{
+			Chunk*       chunk;
+			unsigned int editFrame; // 0 when not edited
+			bool         visible;
+			float        distance;  // squared distance to the view
+		};
 
 		bool _renderDebug;
 
+		Chunk::MeshMode _meshMode;
+		VertexFormat    _vertexFormat;
+
+		// atlas regions as (u, v, width, height) indexed by block type - 1, shared with the chunks
+		std::vector<sgl::Vector4> _tileRegions;
+		// generation of the atlas the regions were resolved from
+		unsigned int _tileRegionsGeneration;
+		// the regions uploaded for PACKED meshes
+		TileRegionBuffer _tileRegionBuffer;
+
+		// index buffer shared by the chunk meshes, sized for the worst case chunk
+		QuadIndexBuffer _quadIndices;
+
+		// how the chunks store light
+		LightModel _lightModel;
+
+		// propagates the light sources of the chunks
+		LightEngine _lightEngine;
+		// one light engine per thread lighting chunk groups in parallel
+		std::vector<LightEngine> _lightWorkers;
+		bool _parallelLighting;
+
+		bool _skyLight;
+		// height of the lowest block open to the sky per column, indexed by x + z * _blockX. -1 until the column is lit
+		std::vector<int> _skyHeights;
+		// columns waiting for sky light
+		std::vector<int> _skyColumns;
+		size_t _nextSkyColumn;
+		int    _skyColumnsPerFrame;
+
+		struct ChunkCoord
+		{
+			int x, y, z;
+		};
+
+		int _loadRadius;     // chunks within this many chunks of the view are loaded, 0 when not streaming
+		int _unloadRadius;   // chunks further than this many chunks from the view are evicted
+		int _loadsPerFrame;
+
+		// offsets of the chunks within the load radius, nearest first
+		std::vector<ChunkCoord> _streamOffsets;
+		// chunks waiting to be generated, nearest first
+		std::vector<ChunkCoord> _loadQueue;
+		size_t _nextLoad;
+
+		sgl::Vector3 _viewPosition;
+		// chunk the load queue was built around
+		ChunkCoord _streamCenter;
+		bool       _streamCenterValid;
+
+		ChunkCallback _chunkGenerator;
+		ChunkCallback _chunkUnloadCallback;
+
+		Timer        _evictionTimer;
+		float        _evictionTime;
+		unsigned int _evictions;
+		float        _evictionsPerSecond;
+
 		sgl::Matrix4 _worldTransform;
 
 		std::string _atlasName;
 
 		bool _updateBoundingVolume;
 
+		// hierarchy over the resident chunks culled as a whole
+		ChunkOctree  _octree;
+		// frustum of the last visibility update
+		ViewFrustum  _frustum;
+		bool         _hasFrustum;
+		// chunks were loaded or unloaded since the last cull
+		bool         _visibilityDirty;
+
+		// reuses the last cull while the view stays within a guard of the last octree walk
+		ChunkCuller  _culler;
+
+		bool _caveCulling;
+		// keys of the chunk coordinates reached by the last walk from the view
+		std::unordered_set<uint64_t> _reachedChunks;
+
+		// depth of the occluders around the view
+		OcclusionBuffer _occlusionBuffer;
+		bool            _occlusionCulling;
+		// chunks within this many chunks of the view are drawn as occluders
+		int             _occluderRadius;
+		unsigned int    _occludedChunks;
+		float           _occlusionTime;
+
 	private:
+		// the chunk at chunk coordinate (x, y, z), created if it isn't resident
 		Chunk& getChunk(int x, int y, int z);
-
+		// the chunk at chunk coordinate (x, y, z), nullptr if it isn't resident
+		Chunk* findChunk(int x, int y, int z);
+
+		Chunk* createChunk(int x, int y, int z);
+		// free the chunks queued for unloading
+		void unloadChunks();
+
+		// generate the nearest queued chunks and requeue the loads and evictions when the view enters another chunk
+		void updateStreaming();
+		void queueStreaming(const ChunkCoord& center);
+
+		// chunk coordinate of the view position
+		ChunkCoord getViewChunk();
+		// position in the untransformed grid of world position, through the inverse of the world transform
+		sgl::Vector3 getGridPosition(const sgl::Vector3& position);
+		// block coordinates of the block containing world position
+		void getGridBlock(const sgl::Vector3& position, int& x, int& y, int& z);
+
+		// raise the sky heights of the columns a chunk that was just generated closes, before it is lit
+		void updateSkyHeights(Chunk& chunk);
+		// seed the light flowing in from the neighbors and the sky into a chunk that was just created
+		void lightNewChunk(Chunk& chunk);
+
+		// chunk coordinate of a block coordinate and the block coordinate within that chunk
+		int getChunkCoord(int b) const;
+		int getLocalCoord(int b) const;
+
+		// rebuild the waiting chunks in priority order within the frame's budget
 		void rebuildChunks();
 
+		// record an edit of block (x, y, z) of chunk, so the chunk and the neighbors sharing the block are rebuilt first
+		void markEdited(Chunk& chunk, int x, int y, int z);
+
+		// resolve the atlas regions again if the atlas was loaded since the last call
+		void updateTileRegions();
+
+		// spread the queued light changes of all chunks and mark the chunks whose light changed for update
+		void updateLighting();
+
+		// spread the queued block light of the chunks in groups that don't share any blocks
+		void spreadLightGroups();
+
+		// mark the chunks whose light engine changed their light for update
+		void markLightChanged(LightEngine& engine);
+
+		// light the next queued columns
+		void updateSkyLight();
+		void lightSkyColumn(int column);
+		// update the column of block (x, y, z) after it was set to type t
+		void updateSkyColumn(int x, int y, int z, int t);
+
+		// type of block (x, y, z) of the grid
+		uint8_t getBlockType(int x, int y, int z);
+
 		void updateChunkVolumes();
 
-		void allocateChunks(int chunkSize, float blockSize);
-		void setChunkNeighbors(Chunk& chunk);
+		// rebuild the render list from the stored frustum
+		void cullChunks();
+		// draw the occluders around the view and remove the chunks they hide from the render list
+		void cullOccludedChunks();
+		// walk the chunks seen through air from the view and remove the others from the render list
+		void cullUnreachableChunks();
+		// world space box of the chunk at chunk coordinate (x, y, z), resident or not
+		void getChunkBox(int x, int y, int z, sgl::Vector3& min, sgl::Vector3& max);
+
+		// point the chunk and the resident chunks around it at each other
+		void linkChunk(Chunk& chunk);
+		void unlinkChunk(Chunk& chunk);
 
 		void updateCallback(Chunk* chunk);
 
@@ -0,0 +1,171 @@
+
+#include "ChunkMesh.h"
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cassert>
+
+using namespace engine;
+using namespace sgl;
+
+int ChunkMesh::_originLocation = -1;
+
+const float ChunkMesh::AO_CURVE[4] = { 0.4f, 0.6f, 0.8f, 1.0f };
+
+ChunkMesh::ChunkMesh(VertexFormat format) :
+	_vao(0),
+	_vbo(0),
+	_indices(nullptr),
+	_format(format),
+	_size(0),
+	_vertexCount(0)
+{
+}
+
+void ChunkMesh::setFormat(VertexFormat format)
+{
+	if (format == _format) return;
+
+	destroy();
+
+	_format = format;
+}
+
+VertexFormat ChunkMesh::getFormat() const
+{
+	return _format;
+}
+
+void ChunkMesh::create()
+{
+	glGenVertexArrays(1, &_vao);
+	glGenBuffers(1, &_vbo);
+
+	glBindVertexArray(_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+
+	// the element buffer binding is part of the vertex array state
+	if (_indices != nullptr)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indices->getId());
+
+	if (_format == VertexFormat::PACKED)
+	{
+		// both words are read as integers and decoded in the shader
+		glEnableVertexAttribArray(0);
+		glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, sizeof(PackedVertex), (void*)0);
+	}
+	else
+	{
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+
+		glEnableVertexAttribArray(4);
+		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, region));
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	_size = 0;
+	_vertexCount = 0;
+}
+
+void ChunkMesh::destroy()
+{
+	if (_vao == 0) return;
+
+	glDeleteBuffers(1, &_vbo);
+	glDeleteVertexArrays(1, &_vao);
+
+	_vbo = 0;
+	_vao = 0;
+
+	_size = 0;
+	_vertexCount = 0;
+}
+
+void ChunkMesh::setIndexBuffer(const QuadIndexBuffer* indices)
+{
+	_indices = indices;
+
+	// meshes that were never uploaded bind the indices when they are created
+	if (_vao == 0) return;
+
+	glBindVertexArray(_vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (_indices != nullptr) ? _indices->getId() : 0);
+	glBindVertexArray(0);
+}
+
+void ChunkMesh::setData(const void* data, unsigned int size, unsigned int vertexCount)
+{
+	// the GL objects are made on the first upload, chunks that are never meshed don't need any
+	if (_vao == 0)
+		create();
+
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+	glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	_size = size;
+	_vertexCount = vertexCount;
+}
+
+void ChunkMesh::draw(const Vector3& origin)
+{
+	if (_vertexCount == 0 || _indices == nullptr) return;
+
+	unsigned int quadCount = _vertexCount / 4;
+	assert(quadCount <= _indices->getQuadCount());
+
+	if (_format == VertexFormat::PACKED)
+	{
+		glUniform3f(_originLocation, origin.x, origin.y, origin.z);
+	}
+
+	glBindVertexArray(_vao);
+	glDrawElements(GL_TRIANGLES, quadCount * 6, _indices->getIndexType(), (void*)0);
+	glBindVertexArray(0);
+}
+
+unsigned int ChunkMesh::getSize() const
+{
+	return _size;
+}
+
+unsigned int ChunkMesh::getVertexCount() const
+{
+	return _vertexCount;
+}
+
+void ChunkMesh::setPackedUniforms(float blockSize, const TileRegionBuffer& regions)
+{
+	GLint program;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+
+	_originLocation = glGetUniformLocation(program, "chunkOrigin");
+
+	glUniform1f(glGetUniformLocation(program, "blockSize"), blockSize);
+	glUniform1fv(glGetUniformLocation(program, "aoCurve"), 4, AO_CURVE);
+
+	GLuint block = glGetUniformBlockIndex(program, "TileRegions");
+
+	if (block != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, block, REGION_BINDING);
+
+	regions.bind(REGION_BINDING);
+}
+
+ChunkMesh::~ChunkMesh()
+{
+	destroy();
+}
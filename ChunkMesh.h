@@ -0,0 +1,98 @@
+
+#ifndef CHUNKMESH_H
+#define CHUNKMESH_H
+
+#include "Block.h"
+#include "QuadIndexBuffer.h"
+#include "TileRegionBuffer.h"
+
+#include <SGL/Math/Vector3.h>
+
+namespace engine
+{
+	/**
+		GPU side mesh of a chunk.
+
+		Vertices are stored as quads of four and drawn through a QuadIndexBuffer shared between meshes.
+		Sets up the vertex attributes for either the float Vertex layout or the integer PackedVertex layout.
+		PACKED meshes are drawn with the packed geometry pass shader, which needs the chunk origin, the block size
+		and the atlas region table as uniforms. The GL objects are created by the first upload
+	*/
+	class ChunkMesh
+	{
+	public:
+
+		ChunkMesh(VertexFormat format);
+		~ChunkMesh();
+
+		/**
+			Change the vertex layout of the mesh. Existing vertex data is discarded
+		*/
+		void setFormat(VertexFormat format);
+
+		/**
+			@return the vertex layout of the mesh
+		*/
+		VertexFormat getFormat() const;
+
+		/**
+			Set the shared index buffer used to draw the quads of this mesh
+		*/
+		void setIndexBuffer(const QuadIndexBuffer* indices);
+
+		/**
+			Upload vertex data, four vertices per quad
+		*/
+		void setData(const void* data, unsigned int size, unsigned int vertexCount);
+
+		/**
+			Draw the mesh. origin is the world position of block corner (0, 0, 0), used by PACKED meshes
+		*/
+		void draw(const sgl::Vector3& origin);
+
+		/**
+			@return the size in bytes of the uploaded vertex data
+		*/
+		unsigned int getSize() const;
+
+		/**
+			@return the number of vertices uploaded
+		*/
+		unsigned int getVertexCount() const;
+
+		/**
+			Set the uniforms shared by all PACKED meshes on the currently bound shader program, including the
+			ambient occlusion curve, and bind the atlas tile regions to its TileRegions block
+		*/
+		static void setPackedUniforms(float blockSize, const TileRegionBuffer& regions);
+
+		// uniform buffer binding point of the tile regions
+		static const unsigned int REGION_BINDING = 0;
+
+		// light scale per ambient occlusion level, 0 is a fully occluded corner. Baked into FLOAT vertices and
+		// passed to the packed geometry pass
+		static const float AO_CURVE[4];
+
+	private:
+
+		unsigned int _vao;
+		unsigned int _vbo;
+
+		const QuadIndexBuffer* _indices;
+
+		VertexFormat _format;
+
+		unsigned int _size;
+		unsigned int _vertexCount;
+
+		// location of the chunk origin uniform in the packed geometry pass
+		static int _originLocation;
+
+	private:
+
+		void create();
+		void destroy();
+	};
+}
+
+#endif
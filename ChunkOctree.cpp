@@ -0,0 +1,272 @@
+
+#include "ChunkOctree.h"
+#include "Chunk.h"
+
+#include <algorithm>
+
+using namespace engine;
+using namespace sgl;
+
+// pack region coordinates into a map key, 21 bits per axis so negative coordinates keep their own keys
+static inline uint64_t getRegionKey(int x, int y, int z)
+{
+	return ((uint64_t)(x & 0x1FFFFF)) | ((uint64_t)(y & 0x1FFFFF) << 21) | ((uint64_t)(z & 0x1FFFFF) << 42);
+}
+
+ChunkOctree::ChunkOctree() :
+	_nodesTested(0)
+{
+}
+
+ChunkOctree::~ChunkOctree()
+{
+	std::unordered_map<uint64_t, Node*>::iterator iter;
+	for (iter = _roots.begin(); iter != _roots.end(); ++iter)
+		destroyNode(iter->second);
+}
+
+void ChunkOctree::insert(Chunk* chunk)
+{
+	Vector3 loc = chunk->getLocation();
+
+	int x = (int)loc.x;
+	int y = (int)loc.y;
+	int z = (int)loc.z;
+
+	// arithmetic shifts round down, so negative chunks fall in the region below them
+	uint64_t key = getRegionKey(x >> DEPTH, y >> DEPTH, z >> DEPTH);
+
+	Node*& root = _roots[key];
+
+	if (root == nullptr)
+		root = createNode(nullptr);
+
+	// descend choosing the child from one bit of the chunk coordinates per level
+	Node* node = root;
+
+	int level;
+	for (level = DEPTH - 1; level >= 0; --level)
+	{
+		int child = ((x >> level) & 1) | (((y >> level) & 1) << 1) | (((z >> level) & 1) << 2);
+
+		if (node->children[child] == nullptr)
+			node->children[child] = createNode(node);
+
+		node = node->children[child];
+	}
+
+	node->chunk = chunk;
+	_leaves[chunk] = node;
+
+	updateAncestors(node);
+}
+
+void ChunkOctree::remove(Chunk* chunk)
+{
+	std::unordered_map<Chunk*, Node*>::iterator iter = _leaves.find(chunk);
+
+	if (iter == _leaves.end()) return;
+
+	Node* leaf = iter->second;
+	_leaves.erase(iter);
+
+	leaf->chunk = nullptr;
+
+	updateAncestors(leaf);
+}
+
+void ChunkOctree::update(Chunk* chunk)
+{
+	std::unordered_map<Chunk*, Node*>::iterator iter = _leaves.find(chunk);
+
+	if (iter != _leaves.end())
+		updateAncestors(iter->second);
+}
+
+void ChunkOctree::updateBounds()
+{
+	std::unordered_map<uint64_t, Node*>::iterator iter;
+	for (iter = _roots.begin(); iter != _roots.end(); ++iter)
+		updateNodeBounds(iter->second);
+}
+
+void ChunkOctree::cull(const ViewFrustum& frustum, float guardDistance, float guardAngle, std::vector<Chunk*>& visible)
+{
+	_nodesTested = 0;
+
+	std::unordered_map<uint64_t, Node*>::iterator iter;
+	for (iter = _roots.begin(); iter != _roots.end(); ++iter)
+		cullNode(iter->second, frustum, guardDistance, guardAngle, false, visible);
+}
+
+unsigned int ChunkOctree::getNodesTested() const
+{
+	return _nodesTested;
+}
+
+ChunkOctree::Node* ChunkOctree::createNode(Node* parent)
+{
+	Node* node = new Node();
+	node->parent = parent;
+	node->chunk  = nullptr;
+	node->empty  = true;
+
+	int i;
+	for (i = 0; i < 8; ++i)
+		node->children[i] = nullptr;
+
+	return node;
+}
+
+void ChunkOctree::destroyNode(Node* node)
+{
+	int i;
+	for (i = 0; i < 8; ++i)
+	{
+		if (node->children[i] != nullptr)
+			destroyNode(node->children[i]);
+	}
+
+	delete node;
+}
+
+void ChunkOctree::calculateBounds(Node* node)
+{
+	bool empty = true;
+
+	if (node->chunk != nullptr && node->chunk->hasGeometry())
+	{
+		node->min = node->chunk->getBoundsMin();
+		node->max = node->chunk->getBoundsMax();
+
+		empty = false;
+	}
+
+	int i;
+	for (i = 0; i < 8; ++i)
+	{
+		Node* child = node->children[i];
+
+		if (child == nullptr || child->empty) continue;
+
+		if (empty)
+		{
+			node->min = child->min;
+			node->max = child->max;
+
+			empty = false;
+		}
+		else
+		{
+			node->min = Vector3(std::min(node->min.x, child->min.x), std::min(node->min.y, child->min.y), std::min(node->min.z, child->min.z));
+			node->max = Vector3(std::max(node->max.x, child->max.x), std::max(node->max.y, child->max.y), std::max(node->max.z, child->max.z));
+		}
+	}
+
+	node->empty = empty;
+}
+
+void ChunkOctree::updateNodeBounds(Node* node)
+{
+	int i;
+	for (i = 0; i < 8; ++i)
+	{
+		if (node->children[i] != nullptr)
+			updateNodeBounds(node->children[i]);
+	}
+
+	calculateBounds(node);
+}
+
+void ChunkOctree::updateAncestors(Node* node)
+{
+	while (node != nullptr)
+	{
+		Node* parent = node->parent;
+
+		calculateBounds(node);
+
+		bool unused = (node->chunk == nullptr);
+
+		int i;
+		for (i = 0; i < 8 && unused; ++i)
+			unused = (node->children[i] == nullptr);
+
+		if (unused)
+		{
+			// nothing is left below this node, unhook it from its parent or drop the region
+			if (parent != nullptr)
+			{
+				for (i = 0; i < 8; ++i)
+				{
+					if (parent->children[i] == node)
+						parent->children[i] = nullptr;
+				}
+			}
+			else
+			{
+				std::unordered_map<uint64_t, Node*>::iterator iter;
+				for (iter = _roots.begin(); iter != _roots.end(); ++iter)
+				{
+					if (iter->second == node)
+					{
+						_roots.erase(iter);
+						break;
+					}
+				}
+			}
+
+			delete node;
+		}
+
+		node = parent;
+	}
+}
+
+void ChunkOctree::cullNode(Node* node, const ViewFrustum& frustum, float guardDistance, float guardAngle, bool inside, std::vector<Chunk*>& visible)
+{
+	if (node->empty) return;
+
+	// a node inside the frustum contains its whole subtree, nothing below needs testing
+	if (inside)
+	{
+		addSubtree(node, visible);
+		return;
+	}
+
+	++_nodesTested;
+
+	ViewFrustum::Side side = frustum.checkBox(node->min, node->max, guardDistance, guardAngle);
+
+	if (side == ViewFrustum::Side::OUTSIDE) return;
+
+	if (node->chunk != nullptr)
+	{
+		addSubtree(node, visible);
+		return;
+	}
+
+	bool contained = side == ViewFrustum::Side::INSIDE;
+
+	int i;
+	for (i = 0; i < 8; ++i)
+	{
+		if (node->children[i] != nullptr)
+			cullNode(node->children[i], frustum, guardDistance, guardAngle, contained, visible);
+	}
+}
+
+void ChunkOctree::addSubtree(Node* node, std::vector<Chunk*>& visible)
+{
+	if (node->empty) return;
+
+	if (node->chunk != nullptr && node->chunk->hasGeometry())
+		visible.push_back(node->chunk);
+
+	int i;
+	for (i = 0; i < 8; ++i)
+	{
+		if (node->children[i] != nullptr)
+			addSubtree(node->children[i], visible);
+	}
+}
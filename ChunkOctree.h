@@ -0,0 +1,104 @@
+
+#ifndef CHUNKOCTREE_H
+#define CHUNKOCTREE_H
+
+#include "ViewFrustum.h"
+
+#include <SGL/Math/Vector3.h>
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace engine
+{
+	class Chunk;
+
+	/**
+		Bounding volume hierarchy over the resident chunks of a grid.
+
+		Chunk coordinates are grouped into root regions of 2^DEPTH chunks per axis, kept in a hash map so the
+		grid can grow in any direction. Each region is an octree whose leaves are chunks. Nodes box the geometry
+		of their children, so the frustum test of a node accepts or rejects its whole subtree at once. Chunks
+		without geometry are kept in the tree but never reported visible
+	*/
+	class ChunkOctree
+	{
+	public:
+
+		// levels below a root region, which covers 2^DEPTH chunks per axis
+		static const int DEPTH = 4;
+
+		ChunkOctree();
+		~ChunkOctree();
+
+		/**
+			Add a chunk at its location. The chunk's bounds must be calculated
+		*/
+		void insert(Chunk* chunk);
+
+		/**
+			Remove a chunk added with insert
+		*/
+		void remove(Chunk* chunk);
+
+		/**
+			Recalculate the bounds of the nodes above a chunk after its bounds changed
+		*/
+		void update(Chunk* chunk);
+
+		/**
+			Recalculate the bounds of every node from the chunk bounds, after the world transform changed
+		*/
+		void updateBounds();
+
+		/**
+			Append the chunks with geometry that may intersect the frustum after the camera moves up to
+			guardDistance and turns up to guardAngle radians. Guards of 0 give the chunks intersecting frustum
+		*/
+		void cull(const ViewFrustum& frustum, float guardDistance, float guardAngle, std::vector<Chunk*>& visible);
+
+		/**
+			@return the number of nodes tested against the frustum by the last cull
+		*/
+		unsigned int getNodesTested() const;
+
+	private:
+
+		struct Node
+		{
+			Node*  parent;
+			Node*  children[8];
+			Chunk* chunk;        // set on leaves only
+
+			// world space box around the geometry of the chunks below, empty when none has geometry
+			sgl::Vector3 min;
+			sgl::Vector3 max;
+			bool         empty;
+		};
+
+		// root regions keyed by their packed region coordinates
+		std::unordered_map<uint64_t, Node*> _roots;
+		// leaf of each chunk, to remove chunks without searching
+		std::unordered_map<Chunk*, Node*> _leaves;
+
+		unsigned int _nodesTested;
+
+	private:
+
+		Node* createNode(Node* parent);
+		void destroyNode(Node* node);
+
+		// recalculate the bounds of node from its children and chunk
+		void calculateBounds(Node* node);
+		void updateNodeBounds(Node* node);
+
+		// walk from a leaf to its root recalculating bounds, freeing nodes left empty
+		void updateAncestors(Node* node);
+
+		void cullNode(Node* node, const ViewFrustum& frustum, float guardDistance, float guardAngle, bool inside, std::vector<Chunk*>& visible);
+		void addSubtree(Node* node, std::vector<Chunk*>& visible);
+	};
+}
+
+#endif
@@ -25,6 +25,8 @@ void DebugDeferredRenderer::init()
 		_geometryPass.addAttribute("vPosition");
 		_geometryPass.addAttribute("vNormal");
 		_geometryPass.addAttribute("vTexCoord");
+		_geometryPass.addAttribute("vColor");
+		_geometryPass.addAttribute("vRegion");
 
 		_geometryPass.bindFragOutput("outNormal");
 		_geometryPass.bindFragOutput("outDiffuse");
@@ -32,6 +34,18 @@ void DebugDeferredRenderer::init()
 
 		_geometryPass.link();
 
+		// load the geometry pass shader for packed vertices
+		_packedGeometryPass.load(ShaderProgram::Type::VERTEX,   GLSL_GEOMETRYPASS_PACKED_VERT);
+		_packedGeometryPass.load(ShaderProgram::Type::FRAGMENT, GLSL_GEOMETRYPASS_FRAG);
+
+		_packedGeometryPass.addAttribute("vData");
+
+		_packedGeometryPass.bindFragOutput("outNormal");
+		_packedGeometryPass.bindFragOutput("outDiffuse");
+		_packedGeometryPass.bindFragOutput("outColor");
+
+		_packedGeometryPass.link();
+
 		// load the light pass shader
 		_lightPass.load(ShaderProgram::Type::VERTEX,   GLSL_LIGHTPASS_VERT);
 		_lightPass.load(ShaderProgram::Type::FRAGMENT, GLSL_DEBUG_LIGHTPASS_FRAG);
@@ -78,9 +92,6 @@ void DebugDeferredRenderer::begin()
 	// clear the gbuffer 
 	Context::clear(Context::BufferBits::COLOR_DEPTH);
 
-	// start the geometry pass
-	_geometryPass.begin();
-
 	// depth testing is required
 	glEnable(GL_DEPTH_TEST);
 }
@@ -93,23 +104,28 @@ void DebugDeferredRenderer::render(ChunkManager& chunkManager, sgl::Matrix4& VP)
 	Matrix4 MVP = VP * M;
 	Matrix3 N = M.toNormalMatrix();
 
-	_geometryPass["MVP"].set(MVP);
-	_geometryPass["N"].set(N);
+	// the geometry pass matching the chunk vertex layout
+	ShaderProgram& geometryPass = (chunkManager.getVertexFormat() == VertexFormat::PACKED) ? _packedGeometryPass : _geometryPass;
+
+	geometryPass.begin();
+
+	geometryPass["MVP"].set(MVP);
+	geometryPass["N"].set(N);
 
 	Texture& texture = VoxelEngine::getEngine()->getResources().getTextureManager().getTexture(chunkManager.getAtlasName());
 	texture.bind(Texture::Unit::T0);
 
-	_geometryPass["blockTexture"].set(texture);
+	geometryPass["blockTexture"].set(texture);
 
 	chunkManager.render();
 
 	texture.unbind();
+
+	geometryPass.end();
 }
 
 void DebugDeferredRenderer::end()
 {
-	_geometryPass.end();
-
 	// render full screen quad using the light pass shader
 
 	// bind gbuffer to access textures
@@ -32,6 +32,8 @@ void DeferredRenderer::init()
 		_geometryPass.addAttribute("vPosition");
 		_geometryPass.addAttribute("vNormal");
 		_geometryPass.addAttribute("vTexCoord");
+		_geometryPass.addAttribute("vColor");
+		_geometryPass.addAttribute("vRegion");
 
 		_geometryPass.bindFragOutput("outNormal");
 		_geometryPass.bindFragOutput("outDiffuse");
@@ -39,6 +41,18 @@ void DeferredRenderer::init()
 
 		_geometryPass.link();
 
+		// load the geometry pass shader for packed vertices
+		_packedGeometryPass.load(ShaderProgram::Type::VERTEX,   GLSL_GEOMETRYPASS_PACKED_VERT);
+		_packedGeometryPass.load(ShaderProgram::Type::FRAGMENT, GLSL_GEOMETRYPASS_FRAG);
+
+		_packedGeometryPass.addAttribute("vData");
+
+		_packedGeometryPass.bindFragOutput("outNormal");
+		_packedGeometryPass.bindFragOutput("outDiffuse");
+		_packedGeometryPass.bindFragOutput("outColor");
+
+		_packedGeometryPass.link();
+
 		// load the light pass shader
 		_lightPass.load(ShaderProgram::Type::VERTEX,   GLSL_LIGHTPASS_VERT);
 		_lightPass.load(ShaderProgram::Type::FRAGMENT, GLSL_LIGHTPASS_FRAG);
@@ -106,9 +120,6 @@ void DeferredRenderer::begin()
 	// clear the gbuffer 
 	Context::clear(Context::BufferBits::COLOR_DEPTH);
 
-	// start the geometry pass
-	_geometryPass.begin();
-
 	// depth testing is required
 	glEnable(GL_DEPTH_TEST);
 }
@@ -121,23 +132,28 @@ void DeferredRenderer::render(ChunkManager& chunkManager, Matrix4& VP)
 	Matrix4 MVP = VP * M;
 	Matrix3 N   = M.toNormalMatrix();
 
-	_geometryPass["MVP"].set(MVP);
-	_geometryPass["N"].set(N);
+	// the geometry pass matching the chunk vertex layout
+	ShaderProgram& geometryPass = (chunkManager.getVertexFormat() == VertexFormat::PACKED) ? _packedGeometryPass : _geometryPass;
+
+	geometryPass.begin();
+
+	geometryPass["MVP"].set(MVP);
+	geometryPass["N"].set(N);
 
 	Texture& texture = VoxelEngine::getEngine()->getResources().getTextureManager().getTexture(chunkManager.getAtlasName());
 	texture.bind(Texture::Unit::T0);
 
-	_geometryPass["blockTexture"].set(texture);
+	geometryPass["blockTexture"].set(texture);
 
 	chunkManager.render();
 
 	texture.unbind();
+
+	geometryPass.end();
 }
 
 void DeferredRenderer::end()
 {
-	_geometryPass.end();
-
 	// render full screen quad using the light pass shader
 
 	// bind gbuffer to access textures
@@ -35,6 +35,7 @@ namespace engine
 
 	private:
 		sgl::ShaderProgram _geometryPass;
+		sgl::ShaderProgram _packedGeometryPass;
 		sgl::ShaderProgram _lightPass;
 
 		GBuffer            _gBuffer;
@@ -19,9 +19,10 @@ FPSCamera::FPSCamera() : FPSCamera(Vector3(0, 0, 0))
 
 FPSCamera::FPSCamera(const sgl::Vector3& position) :
 	position(position),
+	_fov(45),
+	_far(100),
 	_lookAngleH(107),
-	_lookAngleV(75),
-	_fov(45)
+	_lookAngleV(75)
 {
 }
 
@@ -33,10 +34,10 @@ void FPSCamera::update()
 	// update the player projection
 
 	float ratio = Context::getScreenAspectRatio();
-	_proj.perspective(_fov, ratio, 0.1f, 100.0f);
+	_proj.perspective(_fov, ratio, 0.1f, _far);
 
 	// update the view frustum
-	_frustum.construct(_fov, ratio, 0.1f, 100.0f, position, _view);
+	_frustum.construct(_fov, ratio, 0.1f, _far, position, direction, right, up);
 }
 
 void FPSCamera::updateLookDirection(float x, float y, float delta)
@@ -61,7 +62,6 @@ void FPSCamera::calculateView()
 	right.z = cos(_lookAngleH - 3.14f / 2.0f);
 
 	// up
-	Vector3 up;
 	up.set(right).cross(direction);
 
 	//
@@ -88,7 +88,7 @@ sgl::Matrix4& FPSCamera::getProjection(void)
 	return _proj;
 }
 
-sgl::Frustum& FPSCamera::getFrustum(void)
+ViewFrustum& FPSCamera::getFrustum(void)
 {
 	return _frustum;
 }
@@ -97,3 +97,13 @@ void FPSCamera::incrementFOV(float inc)
 {
 	_fov += inc;
 }
+
+void FPSCamera::setFarPlane(float distance)
+{
+	_far = distance;
+}
+
+float FPSCamera::getFarPlane(void) const
+{
+	return _far;
+}
@@ -4,8 +4,9 @@
 
 #include <SGL/Util/PerspectiveCamera.h>
 
+#include "ViewFrustum.h"
+
 #include <SGL/Math/Math.h>
-#include <SGL/Math/Frustum.h>
 
 namespace engine
 {
@@ -26,10 +27,16 @@ namespace engine
 		sgl::Matrix4& getView(void);
 		sgl::Matrix4& getProjection(void);
 
-		sgl::Frustum& getFrustum(void);
+		ViewFrustum& getFrustum(void);
 
 		void incrementFOV(float inc);
 
+		/**
+			Set the distance to the far clipping plane, to match the view distance of the chunk managers
+		*/
+		void setFarPlane(float distance);
+		float getFarPlane(void) const;
+
 		sgl::Vector3& getVerticalVelocity(void);
 		void setVerticalVelocity(float v);
 
@@ -37,15 +44,17 @@ namespace engine
 		sgl::Vector3 position;
 		sgl::Vector3 direction;
 		sgl::Vector3 right;
+		sgl::Vector3 up;
 
 	private:
 
 		sgl::Matrix4 _view;
 		sgl::Matrix4 _proj;
 
-		sgl::Frustum _frustum;
+		ViewFrustum _frustum;
 
 		float _fov;
+		float _far;
 
 		float _lookAngleH;
 		float _lookAngleV;
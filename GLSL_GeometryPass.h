@@ -13,10 +13,12 @@ namespace sgl
 		in vec3 vNormal;
 		in vec2 vTexCoord;
 		in vec3 vColor;
+		in vec4 vRegion;
 
 		out vec3 fNormal;
 		out vec2 fTexCoord;
 		out vec3 fColor;
+		out vec4 fRegion;
 
 		uniform mat4 MVP;
 		uniform mat3 N;
@@ -28,6 +30,67 @@ namespace sgl
 			fNormal   = N * vNormal;
 			fTexCoord = vTexCoord;
 			fColor    = vColor;
+			fRegion   = vRegion;
+		}
+	);
+
+	/**
+		Geometry pass vertex shader for PackedVertex meshes
+	*/
+	const std::string GLSL_GEOMETRYPASS_PACKED_VERT = GLSL(
+		in uvec2 vData;
+
+		out vec3 fNormal;
+		out vec2 fTexCoord;
+		out vec3 fColor;
+		out vec4 fRegion;
+
+		uniform mat4 MVP;
+		uniform mat3 N;
+
+		uniform vec3  chunkOrigin;
+		uniform float blockSize;
+
+		// atlas tile regions, too many for the default uniform block
+		layout(std140) uniform TileRegions
+		{
+			vec4 regions[256];
+		};
+
+		// light scale per ambient occlusion level, set from ChunkMesh::AO_CURVE
+		uniform float aoCurve[4];
+
+		const vec3 normals[6] = vec3[6](
+			vec3(-1,  0,  0),
+			vec3( 1,  0,  0),
+			vec3( 0,  1,  0),
+			vec3( 0, -1,  0),
+			vec3( 0,  0, -1),
+			vec3( 0,  0,  1)
+		);
+
+		void main()
+		{
+			vec3 corner = vec3(vData.x & 0xFFu, (vData.x >> 8) & 0xFFu, (vData.x >> 16) & 0xFFu);
+			uint face   = (vData.x >> 24) & 0x7u;
+			uint ao     = (vData.x >> 27) & 0x3u;
+			uint light  = vData.y & 0xFFFFu;
+
+			gl_Position = MVP * vec4(chunkOrigin + corner * 2.0 * blockSize, 1);
+
+			fNormal = N * normals[face];
+
+			// tile coordinates run along the axes spanning the face
+			if (face < 2u)
+				fTexCoord = corner.zy;
+			else if (face < 4u)
+				fTexCoord = corner.xz;
+			else
+				fTexCoord = corner.yx;
+
+			// sky light is white
+			fColor  = max(vec3(light & 0xFu, (light >> 4) & 0xFu, (light >> 8) & 0xFu), vec3(light >> 12)) / 15.0 * aoCurve[ao];
+			fRegion = regions[vData.y >> 16];
 		}
 	);
 
@@ -40,13 +103,17 @@ namespace sgl
 		in vec3 fNormal;
 		in vec2 fTexCoord;
 		in vec3 fColor;
+		in vec4 fRegion;
 
 		uniform sampler2D blockTexture;
 
 		void main()
 		{
+			// repeat the tile inside of its atlas region
+			vec2 texCoord = fRegion.xy + fract(fTexCoord) * fRegion.zw;
+
 			outNormal  = normalize(fNormal);
-			outDiffuse = texture(blockTexture, fTexCoord).xyz;
+			outDiffuse = texture(blockTexture, texCoord).xyz;
 			outColor   = fColor;
 		}
 	);
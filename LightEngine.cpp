@@ -0,0 +1,675 @@
+
+#include "LightEngine.h"
+
+#include "Chunk.h"
+
+#include <algorithm>
+
+using namespace engine;
+using namespace sgl;
+
+// step to the block next to a face, indexed by BlockFace
+static const int FACE_STEPS[6][3] = {
+	{ -1,  0,  0 }, // left
+	{  1,  0,  0 }, // right
+	{  0,  1,  0 }, // top
+	{  0, -1,  0 }, // bottom
+	{  0,  0, -1 }, // near
+	{  0,  0,  1 }  // far
+};
+
+static inline uint32_t packPos(int x, int y, int z, int level)
+{
+	return (uint32_t)x | ((uint32_t)y << 8) | ((uint32_t)z << 16) | ((uint32_t)level << 24);
+}
+
+static inline int posX(uint32_t pos)     { return (int)(pos & 0xFF); }
+static inline int posY(uint32_t pos)     { return (int)((pos >> 8) & 0xFF); }
+static inline int posZ(uint32_t pos)     { return (int)((pos >> 16) & 0xFF); }
+static inline int posLevel(uint32_t pos) { return (int)(pos >> 24); }
+
+// position of block idx of a chunk with size blocks per axis
+static inline uint32_t packIndex(int idx, int size)
+{
+	return packPos((idx / size) % size, idx / (size * size), idx % size, 0);
+}
+
+// the colored light channels, everything but sky light
+static const light_t COLOR_MASK = R_MASK | G_MASK | B_MASK;
+
+static inline int getMaxColor(light_t light)
+{
+	return std::max(std::max((int)GET_LIGHT_LEVEL_R(light), (int)GET_LIGHT_LEVEL_G(light)), (int)GET_LIGHT_LEVEL_B(light));
+}
+
+static inline int getMaxChannel(light_t light)
+{
+	return std::max(getMaxColor(light), (int)GET_LIGHT_LEVEL_S(light));
+}
+
+// brightest channel over the slots light is stored in for block idx
+static inline int getBlockLevel(Chunk* chunk, int idx, int slots)
+{
+	int level = 0;
+
+	int i;
+	for (i = 0; i < slots; ++i)
+		level = std::max(level, getMaxChannel(chunk->getLight(idx, static_cast<BlockFace>(i))));
+
+	return level;
+}
+
+// brightest sky light over the slots light is stored in for block idx
+static inline int getSkyLevel(Chunk* chunk, int idx, int slots)
+{
+	int level = 0;
+
+	int i;
+	for (i = 0; i < slots; ++i)
+		level = std::max(level, (int)GET_LIGHT_LEVEL_S(chunk->getLight(idx, static_cast<BlockFace>(i))));
+
+	return level;
+}
+
+static inline int getBlockIndex(Chunk* chunk, uint32_t pos)
+{
+	return chunk->getIndex(posX(pos), posY(pos), posZ(pos));
+}
+
+// raise each channel of current to one below the channel in level, where that is brighter
+static inline bool brighten(light_t& current, light_t level)
+{
+	bool brighter = false;
+
+	if (GET_LIGHT_LEVEL_R(current) + 2 <= GET_LIGHT_LEVEL_R(level))
+	{
+		SET_LIGHT_LEVEL_R(current, GET_LIGHT_LEVEL_R(level) - 1);
+		brighter = true;
+	}
+
+	if (GET_LIGHT_LEVEL_G(current) + 2 <= GET_LIGHT_LEVEL_G(level))
+	{
+		SET_LIGHT_LEVEL_G(current, GET_LIGHT_LEVEL_G(level) - 1);
+		brighter = true;
+	}
+
+	if (GET_LIGHT_LEVEL_B(current) + 2 <= GET_LIGHT_LEVEL_B(level))
+	{
+		SET_LIGHT_LEVEL_B(current, GET_LIGHT_LEVEL_B(level) - 1);
+		brighter = true;
+	}
+
+	if (GET_LIGHT_LEVEL_S(current) + 2 <= GET_LIGHT_LEVEL_S(level))
+	{
+		SET_LIGHT_LEVEL_S(current, GET_LIGHT_LEVEL_S(level) - 1);
+		brighter = true;
+	}
+
+	return brighter;
+}
+
+// raise each color channel of current to the channel of a source, where that is brighter
+static inline light_t addSource(light_t current, light_t source)
+{
+	if (GET_LIGHT_LEVEL_R(current) < GET_LIGHT_LEVEL_R(source)) SET_LIGHT_LEVEL_R(current, GET_LIGHT_LEVEL_R(source));
+	if (GET_LIGHT_LEVEL_G(current) < GET_LIGHT_LEVEL_G(source)) SET_LIGHT_LEVEL_G(current, GET_LIGHT_LEVEL_G(source));
+	if (GET_LIGHT_LEVEL_B(current) < GET_LIGHT_LEVEL_B(source)) SET_LIGHT_LEVEL_B(current, GET_LIGHT_LEVEL_B(source));
+
+	return current;
+}
+
+LightEngine::LightEngine(LightModel model) :
+	_model(model),
+	_slots((model == LightModel::PER_VOXEL) ? 1 : 6),
+	_nodesProcessed(0)
+{
+}
+
+void LightEngine::addChunk(Chunk& chunk)
+{
+	if (!chunk.getLightRemovalList().empty())
+		removeLights(chunk);
+
+	Chunk::LightMap& sources = chunk.getLightSourceMap();
+
+	for (int idx : chunk.getPendingLights())
+	{
+		uint32_t pos = packIndex(idx, chunk.getSize());
+
+		Chunk::LightMap::iterator source = sources.find(idx);
+
+		if (source != sources.end())
+		{
+			// new or recolored source
+			seedSource(&chunk, pos, source->second);
+		}
+		else
+		{
+			// an edited block, let the light around it flow in
+			seedNeighbors(&chunk, pos);
+
+			// faces of solid blocks also take the light of the faces beside them, which now reach the faces
+			// the edit opened
+			if (_model == LightModel::PER_FACE)
+				seedEdgeNeighbors(&chunk, pos);
+		}
+	}
+
+	chunk.getPendingLights().clear();
+}
+
+void LightEngine::setSkyLight(Chunk& chunk, int x, int y, int z)
+{
+	int idx = chunk.getIndex(x, y, z);
+
+	int i;
+	for (i = 0; i < _slots; ++i)
+	{
+		light_t light = chunk.getLight(idx, static_cast<BlockFace>(i));
+		SET_LIGHT_LEVEL_S(light, MAX_LIGHT_LEVEL);
+
+		chunk.setLight(idx, static_cast<BlockFace>(i), light);
+	}
+
+	uint32_t pos = packPos(x, y, z, 0);
+
+	markChanged(&chunk, pos);
+
+	seed(&chunk, pos);
+}
+
+void LightEngine::removeSkyLight(Chunk& chunk, int x, int y, int z)
+{
+	int idx   = chunk.getIndex(x, y, z);
+	int level = getSkyLevel(&chunk, idx, _slots);
+
+	if (level == 0) return;
+
+	chunk.clearBlockLight(idx, S_MASK);
+
+	Node node = { &chunk, packPos(x, y, z, level) };
+	markChanged(&chunk, node.pos);
+
+	_skyRemovals.push(node);
+}
+
+void LightEngine::spread()
+{
+	removeSkyLights();
+	propagate();
+}
+
+void LightEngine::spreadGroups(const std::vector<Chunk*>& chunks, std::vector<LightEngine>& workers, util::ThreadPool& pool)
+{
+	// the light of a chunk only reads and writes the chunk and its neighbors, and a block past them. Chunks four
+	// apart on every axis share none of those blocks, so each of the 64 groups can be lit in parallel
+	std::vector<Chunk*> groups[64];
+
+	for (Chunk* chunk : chunks)
+	{
+		Vector3 location = chunk->getLocation();
+
+		int group = ((int)location.x & 3) | (((int)location.y & 3) << 2) | (((int)location.z & 3) << 4);
+		groups[group].push_back(chunk);
+	}
+
+	size_t count = std::min<size_t>(workers.size(), pool.getThreadCount() + 1);
+
+	int i;
+	for (i = 0; i < 64; ++i)
+	{
+		std::vector<Chunk*>& group = groups[i];
+
+		if (group.empty()) continue;
+
+		size_t w;
+		for (w = 0; w < count && w < group.size(); ++w)
+		{
+			LightEngine* worker = &workers[w];
+
+			pool.submit([&group, worker, w, count]
+			{
+				size_t j;
+				for (j = w; j < group.size(); j += count)
+					worker->addChunk(*group[j]);
+
+				worker->spread();
+			});
+		}
+
+		// the next group may reach blocks this one wrote
+		pool.wait();
+	}
+}
+
+std::vector<Chunk*>& LightEngine::getChangedChunks()
+{
+	return _changed;
+}
+
+void LightEngine::removeSkyLights()
+{
+	while (!_skyRemovals.empty())
+	{
+		Node node = _skyRemovals.front();
+		_skyRemovals.pop();
+
+		++_nodesProcessed;
+
+		int level = posLevel(node.pos);
+
+		int face;
+		for (face = 0; face < 6; ++face)
+		{
+			Node adjacent;
+			if (!getNeighbor(node, face, adjacent)) continue;
+
+			int idx = getBlockIndex(adjacent.chunk, adjacent.pos);
+			int sky = getSkyLevel(adjacent.chunk, idx, _slots);
+
+			if (sky == 0) continue;
+
+			// dimmer blocks were lit through the removed block. Full sky light below a removed full sky
+			// block came straight down the column, which is now blocked
+			bool column = (face == static_cast<int>(BlockFace::BOTTOM)) && (level == MAX_LIGHT_LEVEL) && (sky == MAX_LIGHT_LEVEL);
+
+			if (sky < level || column)
+			{
+				adjacent.chunk->clearBlockLight(idx, S_MASK);
+				markChanged(adjacent.chunk, adjacent.pos);
+
+				adjacent.pos = (adjacent.pos & 0x00FFFFFF) | packPos(0, 0, 0, sky);
+				_skyRemovals.push(adjacent);
+			}
+			else
+			{
+				// lit from somewhere else, spread it back into the cleared blocks
+				seed(adjacent.chunk, adjacent.pos);
+			}
+		}
+	}
+}
+
+void LightEngine::seed(Chunk* chunk, uint32_t pos)
+{
+	int level = getBlockLevel(chunk, getBlockIndex(chunk, pos), _slots);
+
+	// a level of one can't brighten anything
+	if (level < 2) return;
+
+	Node node = { chunk, (pos & 0x00FFFFFF) | packPos(0, 0, 0, level) };
+	_buckets[level].push(node);
+}
+
+void LightEngine::seedSource(Chunk* chunk, uint32_t pos, light_t light)
+{
+	int idx = getBlockIndex(chunk, pos);
+
+	// light already reaching the block from elsewhere is kept, the fill ends the same whichever came first
+	int i;
+	for (i = 0; i < _slots; ++i)
+		chunk->setLight(idx, static_cast<BlockFace>(i), addSource(chunk->getLight(idx, static_cast<BlockFace>(i)), light));
+
+	markChanged(chunk, pos);
+
+	seed(chunk, pos);
+}
+
+void LightEngine::seedNeighbors(Chunk* chunk, uint32_t pos)
+{
+	Node node = { chunk, pos };
+
+	int face;
+	for (face = 0; face < 6; ++face)
+	{
+		Node adjacent;
+
+		if (getNeighbor(node, face, adjacent))
+			seed(adjacent.chunk, adjacent.pos);
+	}
+}
+
+void LightEngine::seedEdgeNeighbors(Chunk* chunk, uint32_t pos)
+{
+	Node node = { chunk, pos };
+
+	// step along two faces of different axes, each edge is visited once as the second face is on a later axis
+	int face, other;
+	for (face = 0; face < 4; ++face)
+	{
+		Node adjacent;
+		if (!getNeighbor(node, face, adjacent)) continue;
+
+		for (other = (face | 1) + 1; other < 6; ++other)
+		{
+			Node edge;
+
+			if (getNeighbor(adjacent, other, edge))
+				seed(edge.chunk, edge.pos);
+		}
+	}
+}
+
+void LightEngine::propagate()
+{
+	// emptying the buckets from the top down visits the brightest nodes first, so most blocks get their final
+	// value from the first node that reaches them. A block is queued at its brightest channel, not one below
+	// the node that reached it, as it may hold brighter light of another color that has to spread as far
+	int level;
+	for (level = MAX_LIGHT_LEVEL; level > 1; --level)
+	{
+		util::RingBuffer<Node>& bucket = _buckets[level];
+
+		while (!bucket.empty())
+		{
+			Node node = bucket.front();
+			bucket.pop();
+
+			++_nodesProcessed;
+
+			// the light of the node is read once for its six neighbors
+			light_t sourceLights[6];
+			int sourceIdx = getBlockIndex(node.chunk, node.pos);
+
+			int face;
+			for (face = 0; face < _slots; ++face)
+				sourceLights[face] = node.chunk->getLight(sourceIdx, static_cast<BlockFace>(face));
+
+			for (face = 0; face < 6; ++face)
+			{
+				Node adjacent;
+
+				if (!getNeighbor(node, face, adjacent) || !propagateToNeighbor(sourceLights, adjacent, static_cast<BlockFace>(face))) continue;
+
+				// a block brighter than the current bucket is processed with it, the buckets above are done
+				int next = std::min(getBlockLevel(adjacent.chunk, getBlockIndex(adjacent.chunk, adjacent.pos), _slots), level);
+
+				if (next < 2) continue;
+
+				adjacent.pos = (adjacent.pos & 0x00FFFFFF) | packPos(0, 0, 0, next);
+				_buckets[next].push(adjacent);
+			}
+		}
+	}
+
+	// nodes at level one can't spread
+	_buckets[1].clear();
+	_buckets[0].clear();
+}
+
+bool LightEngine::propagateToNeighbor(const light_t* sourceLights, Node& adjacent, BlockFace face)
+{
+	if (_model == LightModel::PER_VOXEL)
+		return propagateToVoxel(sourceLights[0], adjacent);
+
+	int faceIdx = static_cast<int>(face);
+	int idx     = getBlockIndex(adjacent.chunk, adjacent.pos);
+	bool solid  = adjacent.chunk->getBlockType(idx) != 0;
+
+	bool propagate = false;
+
+	int i;
+
+	// check if the light should propagate through the neighbour block
+	if (solid)
+	{
+		// faces of a solid block take the light of the matching source faces, the face looking back at the
+		// source takes the light of the face pointing at it. Opposite faces differ in the lowest bit
+		for (i = 0; i < 6; ++i)
+		{
+			if (i == faceIdx) continue;
+
+			light_t level = (i == (faceIdx ^ 1)) ? sourceLights[faceIdx] : sourceLights[i];
+
+			propagate |= spreadLight(adjacent, idx, true, static_cast<BlockFace>(i), level);
+		}
+	}
+	else
+	{
+		light_t sourceLevel = sourceLights[faceIdx];
+
+		for (i = 0; i < 6; ++i)
+			propagate |= spreadLight(adjacent, idx, false, static_cast<BlockFace>(i), sourceLevel);
+	}
+
+	return propagate;
+}
+
+bool LightEngine::spreadLight(Node& node, int idx, bool solid, BlockFace face, light_t level)
+{
+	// air is lit on every face, a solid block only on the faces that aren't against another solid block
+	if (solid)
+	{
+		Node neighbour;
+
+		if (getNeighbor(node, static_cast<int>(face), neighbour) && neighbour.chunk->getBlockType(getBlockIndex(neighbour.chunk, neighbour.pos)) != 0)
+			return false;
+	}
+
+	light_t current = node.chunk->getLight(idx, face);
+
+	// if the current level is 2 or more less than the new level it can be brightened
+	if (!brighten(current, level)) return false;
+
+	node.chunk->setLight(idx, face, current);
+	markChanged(node.chunk);
+
+	return true;
+}
+
+bool LightEngine::propagateToVoxel(light_t level, Node& adjacent)
+{
+	Chunk* chunk = adjacent.chunk;
+	int idx = getBlockIndex(chunk, adjacent.pos);
+
+	// light only travels through air
+	if (chunk->getBlockType(idx) != 0) return false;
+
+	light_t current = chunk->getLight(idx, BlockFace::LEFT);
+
+	if (!brighten(current, level)) return false;
+
+	chunk->setLight(idx, BlockFace::LEFT, current);
+	markChanged(chunk, adjacent.pos);
+
+	return true;
+}
+
+void LightEngine::removeLights(Chunk& chunk)
+{
+	_queue.clear();
+
+	Chunk::LightMap& sources = chunk.getLightSourceMap();
+
+	// seed the fill with every removed source, the node level is how far its light reached
+	for (int idx : chunk.getLightRemovalList())
+	{
+		int intensity = 0;
+
+		int i;
+		for (i = 0; i < _slots; ++i)
+			intensity = std::max(intensity, getMaxColor(chunk.getLight(idx, static_cast<BlockFace>(i))));
+
+		// sky light is left alone
+		chunk.clearBlockLight(idx, COLOR_MASK);
+		sources.erase(idx);
+
+		uint32_t pos = packIndex(idx, chunk.getSize());
+		markChanged(&chunk, pos);
+
+		Node node = { &chunk, pos | packPos(0, 0, 0, intensity) };
+		_queue.push(node);
+	}
+
+	chunk.getLightRemovalList().clear();
+
+	// chunks the removal cleared light in
+	_cleared.clear();
+	_cleared.push_back(&chunk);
+
+	// clear every lit block within reach of the removed sources
+	while (!_queue.empty())
+	{
+		Node node = _queue.front();
+		_queue.pop();
+
+		++_nodesProcessed;
+
+		int level = posLevel(node.pos);
+
+		// the edge of the cleared area, light from outside of it can flow back in
+		if (level == 0)
+		{
+			seedNeighbors(node.chunk, node.pos);
+			continue;
+		}
+
+		int face;
+		for (face = 0; face < 6; ++face)
+		{
+			Node adjacent;
+			if (!getNeighbor(node, face, adjacent)) continue;
+
+			int idx = getBlockIndex(adjacent.chunk, adjacent.pos);
+
+			// blocks without light were either never reached or already cleared
+			bool lit = false;
+
+			int i;
+			for (i = 0; i < _slots && !lit; ++i)
+				lit = ((adjacent.chunk->getLight(idx, static_cast<BlockFace>(i)) & COLOR_MASK) != 0);
+
+			if (!lit) continue;
+
+			adjacent.chunk->clearBlockLight(idx, COLOR_MASK);
+			markChanged(adjacent.chunk, adjacent.pos);
+
+			// the fill stays within a few chunks, so a linear search is cheaper than a set
+			if (_cleared.back() != adjacent.chunk && std::find(_cleared.begin(), _cleared.end(), adjacent.chunk) == _cleared.end())
+				_cleared.push_back(adjacent.chunk);
+
+			adjacent.pos = (adjacent.pos & 0x00FFFFFF) | packPos(0, 0, 0, level - 1);
+			_queue.push(adjacent);
+		}
+	}
+
+	// the fill also cleared light from the sources around the removed ones, relight them.
+	// Sources that weren't cleared stop right away as their neighbors are already lit
+	for (Chunk* cleared : _cleared)
+	{
+		for (auto& source : cleared->getLightSourceMap())
+		{
+			seedSource(cleared, packIndex(source.first, cleared->getSize()), source.second);
+		}
+	}
+}
+
+bool LightEngine::getNeighbor(const Node& node, int face, Node& neighbor) const
+{
+	Chunk* chunk = node.chunk;
+	int size = chunk->getSize();
+
+	int x = posX(node.pos) + FACE_STEPS[face][0];
+	int y = posY(node.pos) + FACE_STEPS[face][1];
+	int z = posZ(node.pos) + FACE_STEPS[face][2];
+
+	// only one coordinate changes, so at most one neighbor pointer is followed
+	if (x < 0)
+	{
+		chunk = chunk->left;
+		x += size;
+	}
+	else if (x >= size)
+	{
+		chunk = chunk->right;
+		x -= size;
+	}
+	else if (y < 0)
+	{
+		chunk = chunk->bottom;
+		y += size;
+	}
+	else if (y >= size)
+	{
+		chunk = chunk->top;
+		y -= size;
+	}
+	else if (z < 0)
+	{
+		chunk = chunk->near;
+		z += size;
+	}
+	else if (z >= size)
+	{
+		chunk = chunk->far;
+		z -= size;
+	}
+
+	if (chunk == nullptr) return false;
+
+	neighbor.chunk = chunk;
+	neighbor.pos   = packPos(x, y, z, posLevel(node.pos));
+
+	return true;
+}
+
+void LightEngine::markChanged(Chunk* chunk)
+{
+	// the flag is cleared by whoever takes the changed list
+	if (chunk->isLightChanged()) return;
+
+	chunk->setLightChanged(true);
+	_changed.push_back(chunk);
+}
+
+void LightEngine::markChanged(Chunk* chunk, uint32_t pos)
+{
+	markChanged(chunk);
+
+	if (_model != LightModel::PER_VOXEL) return;
+
+	// faces of the neighboring chunks sample the light of blocks on the border, including the edge and corner
+	// neighbors whose face corners average it
+	int size = chunk->getSize();
+
+	int p[3] = { posX(pos), posY(pos), posZ(pos) };
+
+	// the sides the block touches along each axis, -1, 1 or 0 for none
+	int touch[3];
+
+	int i;
+	for (i = 0; i < 3; ++i)
+		touch[i] = (p[i] == 0) ? -1 : (p[i] == size - 1) ? 1 : 0;
+
+	int dx, dy, dz;
+	for (dx = -1; dx <= 1; ++dx)
+	{
+		for (dy = -1; dy <= 1; ++dy)
+		{
+			for (dz = -1; dz <= 1; ++dz)
+			{
+				if ((dx == 0 && dy == 0 && dz == 0) || (dx != 0 && dx != touch[0]) || (dy != 0 && dy != touch[1]) || (dz != 0 && dz != touch[2]))
+					continue;
+
+				Chunk* adjacent = chunk;
+
+				if (adjacent != nullptr && dx != 0) adjacent = (dx < 0) ? adjacent->left   : adjacent->right;
+				if (adjacent != nullptr && dy != 0) adjacent = (dy < 0) ? adjacent->bottom : adjacent->top;
+				if (adjacent != nullptr && dz != 0) adjacent = (dz < 0) ? adjacent->near   : adjacent->far;
+
+				if (adjacent != nullptr)
+					markChanged(adjacent);
+			}
+		}
+	}
+}
+
+unsigned int LightEngine::getNodesProcessed() const
+{
+	return _nodesProcessed;
+}
+
+void LightEngine::resetStats()
+{
+	_nodesProcessed = 0;
+}
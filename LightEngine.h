@@ -0,0 +1,151 @@
+
+#ifndef LIGHTENGINE_H
+#define LIGHTENGINE_H
+
+#include "Block.h"
+#include "RingBuffer.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace engine
+{
+	class Chunk;
+
+	/**
+		Flood fill lighting over the chunk grid.
+
+		Nodes are a chunk and the block's chunk local coordinates packed into one word, queued in ring buffers
+		that are reused between fills. Neighbors are found by stepping a single neighbor pointer when a coordinate
+		leaves the chunk, and light values are read and written directly in the chunks' flat light arrays.
+
+		All changed lights are seeded into one fill that runs brightest first, using a bucket per light level,
+		so overlapping sources don't flood the same blocks over and over.
+
+		Light is either stored per face of every block, spreading over the faces of solid blocks, or per voxel,
+		only spreading through air.
+
+		Chunks are only collected when one of their light values is written, not when the fill merely visits
+		them, so the caller remeshes each changed chunk once per frame
+	*/
+	class LightEngine
+	{
+	public:
+
+		/**
+			Create an engine spreading light stored in the layout of model, which must match the chunks it lights
+		*/
+		LightEngine(LightModel model);
+
+		/**
+			Clear the light of the sources queued for removal in chunk and queue its pending blocks, new light
+			sources and blocks next to edits, to be spread by the next call to spread.
+			Sources that didn't change are skipped
+		*/
+		void addChunk(Chunk& chunk);
+
+		/**
+			Give block (x, y, z) of chunk full sky light and queue it to spread. Used for the blocks of a column
+			open to the sky
+		*/
+		void setSkyLight(Chunk& chunk, int x, int y, int z);
+
+		/**
+			Queue the sky light of block (x, y, z) of chunk for removal, along with the sky light that came through it
+		*/
+		void removeSkyLight(Chunk& chunk, int x, int y, int z);
+
+		/**
+			Process the queued light changes in a single fill
+		*/
+		void spread();
+
+		/**
+			Process the queued light changes of chunks on the threads of pool, with one engine of workers per
+			thread plus the calling one. Chunks four apart on every axis are lit at the same time, which only
+			keeps them apart when a chunk is at least LIGHT_RANGE blocks wide. The light ends up the same as when
+			every chunk is added to one engine and spread once
+		*/
+		static void spreadGroups(const std::vector<Chunk*>& chunks, std::vector<LightEngine>& workers, util::ThreadPool& pool);
+
+		/**
+			@return the chunks whose light values changed. The caller takes care of remeshing them, clearing
+			their light changed flag and emptying the list
+		*/
+		std::vector<Chunk*>& getChangedChunks();
+
+		/**
+			@return the number of nodes taken off the queue since the last resetStats
+		*/
+		unsigned int getNodesProcessed() const;
+
+		void resetStats();
+
+	private:
+
+		struct Node
+		{
+			Chunk*   chunk;
+			uint32_t pos;   // x | y << 8 | z << 16 | level << 24
+		};
+
+		// removal queue
+		util::RingBuffer<Node> _queue;
+		// sky light removal queue, kept between calls to spread
+		util::RingBuffer<Node> _skyRemovals;
+		// propagation queue, one bucket per light level
+		util::RingBuffer<Node> _buckets[MAX_LIGHT_LEVEL + 1];
+
+		// chunks with changed light values
+		std::vector<Chunk*> _changed;
+		// chunks the current removal cleared light in
+		std::vector<Chunk*> _cleared;
+
+		LightModel _model;
+		// number of light values per block, 6 per face or 1 per voxel
+		int _slots;
+
+		unsigned int _nodesProcessed;
+
+	private:
+
+		// queue the block at pos to spread its light
+		void seed(Chunk* chunk, uint32_t pos);
+
+		// write the light of a source into the block at pos and queue it to spread
+		void seedSource(Chunk* chunk, uint32_t pos, light_t light);
+
+		// queue the blocks around the block at pos to spread their light into it
+		void seedNeighbors(Chunk* chunk, uint32_t pos);
+
+		// queue the 12 blocks sharing an edge with the block at pos to spread their light
+		void seedEdgeNeighbors(Chunk* chunk, uint32_t pos);
+
+		// spread the light of the seeded blocks, brightest first
+		void propagate();
+
+		// clear the light around the removed sources of chunk, then seed the sources around them again
+		void removeLights(Chunk& chunk);
+
+		// clear the sky light that came through the queued blocks and seed the sky light around them
+		void removeSkyLights();
+
+		// spread the light of a source block into adjacent, which lies in direction face of it. sourceLights
+		// holds the light of the source in each slot
+		bool propagateToNeighbor(const light_t* sourceLights, Node& adjacent, BlockFace face);
+		// per voxel light only reaches air blocks and has no faces to spread over
+		bool propagateToVoxel(light_t level, Node& adjacent);
+		// brighten one face of block idx of node, a solid block is only lit on faces not against another solid block
+		bool spreadLight(Node& node, int idx, bool solid, BlockFace face, light_t level);
+
+		// find the node next to node in direction face, false if it is outside of the grid
+		bool getNeighbor(const Node& node, int face, Node& neighbor) const;
+
+		void markChanged(Chunk* chunk);
+		// mark the chunk of a block whose light changed, and the neighbors sampling it with per voxel light
+		void markChanged(Chunk* chunk, uint32_t pos);
+	};
+}
+
+#endif
@@ -0,0 +1,175 @@
+
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+using namespace engine;
+using namespace sgl;
+
+// clamp a screen coordinate to [0, size] before converting it, points near the eye project far off screen
+static inline float clampScreen(float v, int size)
+{
+	return std::min(std::max(v, 0.0f), (float)size);
+}
+
+OcclusionBuffer::OcclusionBuffer(int width, int height) :
+	_width(width),
+	_height(height)
+{
+	_depth.assign(width * height, FLT_MAX);
+}
+
+void OcclusionBuffer::clear(const ViewFrustum& frustum)
+{
+	_frustum = frustum;
+
+	std::fill(_depth.begin(), _depth.end(), FLT_MAX);
+}
+
+void OcclusionBuffer::drawQuad(const Vector3 corners[4])
+{
+	float screen[4][2];
+	float depth = 0;
+
+	int i;
+	for (i = 0; i < 4; ++i)
+	{
+		float z;
+
+		// clipping against the near plane would only add coverage close to the eye, where chunks are visible anyway
+		if (!toScreen(corners[i], screen[i][0], screen[i][1], z)) return;
+
+		depth = std::max(depth, z);
+	}
+
+	// a face stays convex under projection, filled as a whole no pixel is lost along a diagonal
+	fillQuad(screen, depth);
+}
+
+bool OcclusionBuffer::isOccluded(const Vector3& min, const Vector3& max) const
+{
+	float x0 = FLT_MAX, y0 = FLT_MAX;
+	float x1 = -FLT_MAX, y1 = -FLT_MAX;
+	float nearest = FLT_MAX;
+
+	int i;
+	for (i = 0; i < 8; ++i)
+	{
+		Vector3 corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+
+		float x, y, z;
+
+		// a box reaching past the near plane surrounds the eye or is right in front of it
+		if (!toScreen(corner, x, y, z)) return false;
+
+		x0 = std::min(x0, x);
+		y0 = std::min(y0, y);
+		x1 = std::max(x1, x);
+		y1 = std::max(y1, y);
+
+		nearest = std::min(nearest, z);
+	}
+
+	// every pixel the box touches
+	int px0 = (int)std::floor(clampScreen(x0, _width));
+	int py0 = (int)std::floor(clampScreen(y0, _height));
+	int px1 = (int)std::ceil(clampScreen(x1, _width)) - 1;
+	int py1 = (int)std::ceil(clampScreen(y1, _height)) - 1;
+
+	// off screen boxes are left to the frustum test
+	if (px0 > px1 || py0 > py1) return false;
+
+	int x, y;
+	for (y = py0; y <= py1; ++y)
+	{
+		const float* row = &_depth[y * _width];
+
+		for (x = px0; x <= px1; ++x)
+		{
+			if (row[x] >= nearest) return false;
+		}
+	}
+
+	return true;
+}
+
+bool OcclusionBuffer::toScreen(const Vector3& p, float& x, float& y, float& depth) const
+{
+	if (!_frustum.project(p, x, y, depth)) return false;
+
+	x = (x * 0.5f + 0.5f) * _width;
+	y = (y * 0.5f + 0.5f) * _height;
+
+	return true;
+}
+
+void OcclusionBuffer::fillQuad(float (*quad)[2], float depth)
+{
+	float area = 0;
+
+	int i;
+	for (i = 0; i < 4; ++i)
+	{
+		const float* a = quad[i];
+		const float* b = quad[(i + 1) & 3];
+
+		area += a[0] * b[1] - b[0] * a[1];
+	}
+
+	if (area == 0) return;
+
+	// wind the quad counter clockwise so the edge functions are positive inside
+	if (area < 0) std::swap(quad[1], quad[3]);
+
+	// edge functions, positive on the inside of each edge. Occluders have to be conservative, so a pixel is
+	// only written when all of it is inside the quad. An edge function is linear, its lowest value over a
+	// pixel is at the corner half a pixel from the center along each axis against the edge normal
+	float ex[4], ey[4], ec[4];
+
+	float x0 = FLT_MAX, y0 = FLT_MAX;
+	float x1 = -FLT_MAX, y1 = -FLT_MAX;
+
+	for (i = 0; i < 4; ++i)
+	{
+		const float* a = quad[i];
+		const float* b = quad[(i + 1) & 3];
+
+		ex[i] = a[1] - b[1];
+		ey[i] = b[0] - a[0];
+		ec[i] = -a[0] * ex[i] - a[1] * ey[i] - 0.5f * (std::fabs(ex[i]) + std::fabs(ey[i]));
+
+		x0 = std::min(x0, a[0]);
+		y0 = std::min(y0, a[1]);
+		x1 = std::max(x1, a[0]);
+		y1 = std::max(y1, a[1]);
+	}
+
+	int px0 = (int)std::floor(clampScreen(x0, _width));
+	int py0 = (int)std::floor(clampScreen(y0, _height));
+	int px1 = (int)std::ceil(clampScreen(x1, _width)) - 1;
+	int py1 = (int)std::ceil(clampScreen(y1, _height)) - 1;
+
+	// the row loop has no branches so it vectorizes
+	int x, y;
+	for (y = py0; y <= py1; ++y)
+	{
+		float cy = y + 0.5f;
+		float* row = &_depth[y * _width];
+
+		for (x = px0; x <= px1; ++x)
+		{
+			float cx = x + 0.5f;
+
+			float w0 = cx * ex[0] + cy * ey[0] + ec[0];
+			float w1 = cx * ex[1] + cy * ey[1] + ec[1];
+			float w2 = cx * ex[2] + cy * ey[2] + ec[2];
+			float w3 = cx * ex[3] + cy * ey[3] + ec[3];
+
+			bool inside = (w0 >= 0) & (w1 >= 0) & (w2 >= 0) & (w3 >= 0);
+
+			row[x] = (inside & (depth < row[x])) ? depth : row[x];
+		}
+	}
+}
@@ -0,0 +1,61 @@
+
+#ifndef OCCLUSIONBUFFER_H
+#define OCCLUSIONBUFFER_H
+
+#include "ViewFrustum.h"
+
+#include <SGL/Math/Vector3.h>
+
+#include <vector>
+
+namespace engine
+{
+	/**
+		Low resolution depth buffer drawn on the CPU to cull chunks hidden behind terrain.
+
+		Occluders are quads drawn at the depth of their furthest corner, so the buffer never holds a depth
+		nearer than the real surface. A box is occluded when every pixel it could cover holds a depth in front
+		of its nearest corner. Depth is the distance along the view direction, which is linear over the buffer
+	*/
+	class OcclusionBuffer
+	{
+	public:
+
+		OcclusionBuffer(int width, int height);
+
+		/**
+			Clear the buffer to draw a new view
+		*/
+		void clear(const ViewFrustum& frustum);
+
+		/**
+			Draw the opaque quad with the corners in order around its edge. Quads crossing the near plane are skipped
+		*/
+		void drawQuad(const sgl::Vector3 corners[4]);
+
+		/**
+			@return true if the axis aligned box from min to max is hidden behind the quads drawn so far
+		*/
+		bool isOccluded(const sgl::Vector3& min, const sgl::Vector3& max) const;
+
+	private:
+
+		int _width;
+		int _height;
+
+		// one depth per pixel, rows from the bottom of the view
+		std::vector<float> _depth;
+
+		ViewFrustum _frustum;
+
+	private:
+
+		// project p to pixel coordinates, false if it is closer than the near plane
+		bool toScreen(const sgl::Vector3& p, float& x, float& y, float& depth) const;
+
+		// fill the pixels lying entirely in the convex quad given as screen x, y pairs in order around its edge
+		void fillQuad(float (*quad)[2], float depth);
+	};
+}
+
+#endif
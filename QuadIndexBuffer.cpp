@@ -0,0 +1,89 @@
+
+#include "QuadIndexBuffer.h"
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cstdint>
+
+using namespace engine;
+
+QuadIndexBuffer::QuadIndexBuffer() :
+	_ibo(0),
+	_indexType(GL_UNSIGNED_SHORT),
+	_quadCount(0)
+{
+}
+
+void QuadIndexBuffer::create(unsigned int quadCount)
+{
+	if (_ibo == 0)
+		glGenBuffers(1, &_ibo);
+
+	// use 16 bit indices when every vertex can be addressed by them
+	if (quadCount * 4 <= 0x10000)
+	{
+		_indexType = GL_UNSIGNED_SHORT;
+		fill<uint16_t>(quadCount);
+	}
+	else
+	{
+		_indexType = GL_UNSIGNED_INT;
+		fill<uint32_t>(quadCount);
+	}
+
+	_quadCount = quadCount;
+}
+
+template<typename T>
+void QuadIndexBuffer::fill(unsigned int quadCount)
+{
+	std::vector<T> indices;
+	indices.reserve(quadCount * 6);
+
+	unsigned int q;
+	for (q = 0; q < quadCount; ++q)
+	{
+		T base = (T)(q * 4);
+
+		indices.push_back(base);
+		indices.push_back(base + 1);
+		indices.push_back(base + 2);
+
+		indices.push_back(base + 2);
+		indices.push_back(base + 3);
+		indices.push_back(base);
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(T), indices.empty() ? 0 : &indices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+unsigned int QuadIndexBuffer::getId() const
+{
+	return _ibo;
+}
+
+unsigned int QuadIndexBuffer::getIndexType() const
+{
+	return _indexType;
+}
+
+unsigned int QuadIndexBuffer::getQuadCount() const
+{
+	return _quadCount;
+}
+
+unsigned int QuadIndexBuffer::getMaxChunkQuads(int size)
+{
+	// a checker board of blocks exposes all six faces of half the blocks
+	unsigned int blocks = (unsigned int)(size * size * size);
+	return ((blocks + 1) / 2) * 6;
+}
+
+QuadIndexBuffer::~QuadIndexBuffer()
+{
+	if (_ibo != 0)
+		glDeleteBuffers(1, &_ibo);
+}
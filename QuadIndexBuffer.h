@@ -0,0 +1,58 @@
+
+#ifndef QUADINDEXBUFFER_H
+#define QUADINDEXBUFFER_H
+
+namespace engine
+{
+	/**
+		Element buffer for drawing quads stored as four vertices each.
+
+		Quad q is drawn as the triangles (4q, 4q + 1, 4q + 2) and (4q + 2, 4q + 3, 4q).
+		The buffer is built once and shared by every mesh that draws quads
+	*/
+	class QuadIndexBuffer
+	{
+	public:
+
+		QuadIndexBuffer();
+		~QuadIndexBuffer();
+
+		/**
+			Build indices for up to quadCount quads
+		*/
+		void create(unsigned int quadCount);
+
+		/**
+			@return the GL buffer name
+		*/
+		unsigned int getId() const;
+
+		/**
+			@return the GL type of the indices
+		*/
+		unsigned int getIndexType() const;
+
+		/**
+			@return the number of quads the buffer can draw
+		*/
+		unsigned int getQuadCount() const;
+
+		/**
+			@return the worst case number of quads in a chunk with size blocks per axis
+		*/
+		static unsigned int getMaxChunkQuads(int size);
+
+	private:
+
+		unsigned int _ibo;
+		unsigned int _indexType;
+		unsigned int _quadCount;
+
+	private:
+
+		template<typename T>
+		void fill(unsigned int quadCount);
+	};
+}
+
+#endif
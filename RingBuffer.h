@@ -0,0 +1,92 @@
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <vector>
+#include <cstddef>
+#include <cassert>
+
+namespace engine
+{
+	namespace util
+	{
+		/**
+			FIFO queue stored in a contiguous array that wraps around.
+
+			The capacity doubles when the queue is full and never shrinks, so a queue reused between
+			flood fills stops allocating once it has seen the largest fill
+		*/
+		template<typename T>
+		class RingBuffer
+		{
+		public:
+
+			RingBuffer() : _head(0), _count(0)
+			{
+				_items.resize(64);
+			}
+
+			void push(const T& item)
+			{
+				if (_count == _items.size()) grow();
+
+				_items[(_head + _count) & (_items.size() - 1)] = item;
+				++_count;
+			}
+
+			T& front()
+			{
+				assert(_count > 0);
+				return _items[_head];
+			}
+
+			void pop()
+			{
+				assert(_count > 0);
+
+				_head = (_head + 1) & (_items.size() - 1);
+				--_count;
+			}
+
+			bool empty() const
+			{
+				return _count == 0;
+			}
+
+			size_t size() const
+			{
+				return _count;
+			}
+
+			void clear()
+			{
+				_head  = 0;
+				_count = 0;
+			}
+
+		private:
+
+			// capacity is always a power of two so indices wrap with a mask
+			std::vector<T> _items;
+
+			size_t _head;
+			size_t _count;
+
+		private:
+
+			void grow()
+			{
+				std::vector<T> items(_items.size() * 2);
+
+				size_t i;
+				for (i = 0; i < _count; ++i)
+					items[i] = _items[(_head + i) & (_items.size() - 1)];
+
+				_items.swap(items);
+				_head = 0;
+			}
+		};
+	}
+}
+
+#endif
@@ -11,9 +11,33 @@
 
 #include <SGL/Math/Vector3.h>
 
+#include <functional>
+
 using namespace engine;
 using namespace engine::script;
 
+// a Lua function called with the chunk itself, so the script fills or saves it in place. Anything but a function
+// clears the callback
+static ChunkManager::ChunkCallback getChunkCallback(const luabind::object& function)
+{
+	if (luabind::type(function) != LUA_TFUNCTION) return nullptr;
+
+	return [function](Chunk& chunk)
+	{
+		luabind::call_function<void>(function, std::ref(chunk));
+	};
+}
+
+static void setChunkGenerator(ChunkManager& manager, const luabind::object& generator)
+{
+	manager.setChunkGenerator(getChunkCallback(generator));
+}
+
+static void setChunkUnloadCallback(ChunkManager& manager, const luabind::object& callback)
+{
+	manager.setChunkUnloadCallback(getChunkCallback(callback));
+}
+
 ScriptEngine::ScriptEngine() : _errorCallback(nullptr)
 {
 	_state = luaL_newstate();
@@ -49,31 +73,72 @@ void ScriptEngine::init()
 			.def("getCommandLine",   &VoxelEngine::getCommandLine),
 
 		class_<Block>("Block")
-			.def_readonly("t", &Block::t)
-			.def_readonly("x", &Block::x)
-			.def_readonly("y", &Block::y)
-			.def_readonly("z", &Block::z),
+			.def_readonly("t", &Block::t),
+
+		// chunks are only handed to the streaming callbacks, in chunk local block coordinates
+		class_<Chunk>("Chunk")
+			.def("getBlock",    (Block(Chunk::*)(int, int, int))&Chunk::getBlock)
+			.def("setBlock",    &Chunk::setBlock)
+			.def("getSize",     &Chunk::getSize)
+			.def("getLocation", &Chunk::getLocation),
 
 		class_<ChunkManager>("ChunkManager")
 			.def(constructor<int, int, int, const char *>())
 			.def(constructor<int, int, int, int, float, const char *>())
-			.def("getBlock",       &ChunkManager::getBlock)
-			.def("setBlock",       &ChunkManager::setBlock)
-			.def("setLightSource", &ChunkManager::setLightSource)
-			.def("removeLight",    &ChunkManager::removeLight)
-			.def("setAtlasName",   &ChunkManager::setAtlasName)
-			.def("getBlockX",      &ChunkManager::getBlockX)
-			.def("getBlockY",      &ChunkManager::getBlockY)
-			.def("getBlockZ",      &ChunkManager::getBlockZ)
-			.def("setRenderDebug", &ChunkManager::setRenderDebug)
-			.def("translate",      &ChunkManager::translate)
-			.def("rotate",         &ChunkManager::rotate)
-			.def("scale",          &ChunkManager::scale),
+			.def(constructor<int, int, int, int, float, const char *, LightModel>())
+			.def("getBlock",              &ChunkManager::getBlock)
+			.def("setBlock",              &ChunkManager::setBlock)
+			.def("setLightSource",        &ChunkManager::setLightSource)
+			.def("removeLight",           &ChunkManager::removeLight)
+			.def("setAtlasName",          &ChunkManager::setAtlasName)
+			.def("getBlockX",             &ChunkManager::getBlockX)
+			.def("getBlockY",             &ChunkManager::getBlockY)
+			.def("getBlockZ",             &ChunkManager::getBlockZ)
+			.def("setRenderDebug",        &ChunkManager::setRenderDebug)
+			.def("enableSkyLight",        &ChunkManager::enableSkyLight)
+			.def("setMeshMode",           &ChunkManager::setMeshMode)
+			.def("setVertexFormat",       &ChunkManager::setVertexFormat)
+			.def("setViewRadius",         &ChunkManager::setViewRadius)
+			.def("setChunkGenerator",     &setChunkGenerator)
+			.def("setChunkUnloadCallback", &setChunkUnloadCallback)
+			.def("setLoadsPerFrame",      &ChunkManager::setLoadsPerFrame)
+			.def("setRebuildBudget",      &ChunkManager::setRebuildBudget)
+			.def("getChunkCount",         &ChunkManager::getChunkCount)
+			.def("getQueuedLoadCount",    &ChunkManager::getQueuedLoadCount)
+			.def("getEvictionsPerSecond", &ChunkManager::getEvictionsPerSecond)
+			.def("setVisibilityGuard",    &ChunkManager::setVisibilityGuard)
+			.def("setCaveCulling",        &ChunkManager::setCaveCulling)
+			.def("setOcclusionCulling",   &ChunkManager::setOcclusionCulling)
+			.def("getVisibleChunkCount",  &ChunkManager::getVisibleChunkCount)
+			.def("getOccludedChunkCount", &ChunkManager::getOccludedChunkCount)
+			.def("getOcclusionTime",      &ChunkManager::getOcclusionTime)
+			.def("translate",             &ChunkManager::translate)
+			.def("rotate",                &ChunkManager::rotate)
+			.def("scale",                 &ChunkManager::scale)
+
+			// mesh modes
+			.enum_("mesh_modes")[
+				value("MESH_CUBE",   (int)Chunk::MeshMode::CUBE),
+				value("MESH_GREEDY", (int)Chunk::MeshMode::GREEDY)
+			]
+
+			// vertex formats
+			.enum_("vertex_formats")[
+				value("VERTEX_FLOAT",  (int)VertexFormat::FLOAT),
+				value("VERTEX_PACKED", (int)VertexFormat::PACKED)
+			]
+
+			// light models, passed to the constructor
+			.enum_("light_models")[
+				value("LIGHT_PER_FACE",  (int)LightModel::PER_FACE),
+				value("LIGHT_PER_VOXEL", (int)LightModel::PER_VOXEL)
+			],
 
 		class_<FPSCamera>("Camera")
 			.def_readwrite("position",  &FPSCamera::position)
 			.def_readwrite("direction", &FPSCamera::direction)
-			.def_readwrite("right",     &FPSCamera::right),
+			.def_readwrite("right",     &FPSCamera::right)
+			.def("setFarPlane",         &FPSCamera::setFarPlane),
 
 		class_<gui::CommandLine>("CommandLine")
 			.def(constructor<>())
@@ -13,7 +13,10 @@
 using namespace engine;
 using namespace sgl;
 
-TextureAtlas::TextureAtlas(Texture* texture, const std::string& packFilename)
+unsigned int TextureAtlas::_nextGeneration = 1;
+
+TextureAtlas::TextureAtlas(Texture* texture, const std::string& packFilename) :
+	_generation(0)
 {
 	load(texture, packFilename);
 }
@@ -39,6 +42,9 @@ void TextureAtlas::load(Texture* texture, const std::string& packFilename)
 	// get the optional inversion value from the json file
 	bool inverted = (pt.count("inverted")) ? pt.get<bool>("inverted") : false;
 
+	_regions.clear();
+	_generation = _nextGeneration++;
+
 	// get the pixel dimensions to calculate the texture region
 	BOOST_FOREACH(ptree::value_type& v, pt.get_child("atlas"))
 	{
@@ -61,6 +67,30 @@ Texture::TextureRegion& TextureAtlas::getRegion(Block block)
 	return _regions[block.t - 1];
 }
 
+Vector4 TextureAtlas::getTileRegion(unsigned int idx)
+{
+	assert(idx < _regions.size());
+
+	Texture::TextureRegion& region = _regions[idx];
+
+	return Vector4(
+		region.topLeft.x,
+		region.topLeft.y,
+		region.topRight.x   - region.topLeft.x,
+		region.bottomLeft.y - region.topLeft.y
+	);
+}
+
+unsigned int TextureAtlas::getRegionCount() const
+{
+	return (unsigned int)_regions.size();
+}
+
+unsigned int TextureAtlas::getGeneration() const
+{
+	return _generation;
+}
+
 TextureAtlas::~TextureAtlas()
 {
 }
@@ -5,6 +5,7 @@
 #include "Block.h"
 
 #include <SGL/GL/Texture.h>
+#include <SGL/Math/Vector4.h>
 
 #include <vector>
 
@@ -21,8 +22,29 @@ namespace engine
 
 		sgl::Texture::TextureRegion& getRegion(Block block);
 
+		/**
+			@return region idx as (u, v, width, height). The origin is the top left corner, u runs towards the
+			top right and v towards the bottom left corner
+		*/
+		sgl::Vector4 getTileRegion(unsigned int idx);
+
+		/**
+			@return the number of regions in the atlas
+		*/
+		unsigned int getRegionCount() const;
+
+		/**
+			@return a number that changes every time an atlas is loaded, used to detect stale region tables
+		*/
+		unsigned int getGeneration() const;
+
 	private:
 		std::vector<sgl::Texture::TextureRegion> _regions;
+
+		unsigned int _generation;
+
+		// generation given to the next atlas loaded
+		static unsigned int _nextGeneration;
 	
 	};
 }
@@ -0,0 +1,159 @@
+
+#include "ThreadPool.h"
+
+using namespace engine::util;
+
+ThreadPool::ThreadPool() : ThreadPool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1)
+{
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount) :
+	_queued(0),
+	_pending(0),
+	_nextQueue(0),
+	_running(true)
+{
+	if (threadCount == 0) threadCount = 1;
+
+	unsigned int i;
+	for (i = 0; i < threadCount; ++i)
+	{
+		_queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+	}
+
+	for (i = 0; i < threadCount; ++i)
+	{
+		_workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+void ThreadPool::submit(const Task& task)
+{
+	// distribute tasks over the worker queues, stealing balances out any unevenness
+	unsigned int idx = _nextQueue++ % _queues.size();
+
+	// count the task before it can be taken, a worker finishing it first would drop the counts below zero
+	_pending++;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queued++;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_queues[idx]->mutex);
+		_queues[idx]->tasks.push_back(task);
+	}
+
+	_workAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	Task task;
+
+	while (_pending > 0)
+	{
+		// help out instead of sleeping
+		if (stealTask((unsigned int)_queues.size(), task))
+		{
+			runTask(task);
+		}
+		else
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_workDone.wait(lock, [this]{ return _pending == 0 || _queued > 0; });
+		}
+	}
+}
+
+unsigned int ThreadPool::getThreadCount() const
+{
+	return (unsigned int)_workers.size();
+}
+
+void ThreadPool::workerLoop(unsigned int idx)
+{
+	Task task;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_workAvailable.wait(lock, [this]{ return _queued > 0 || !_running; });
+
+			if (!_running) return;
+		}
+
+		if (popTask(idx, task) || stealTask(idx, task))
+		{
+			runTask(task);
+		}
+	}
+}
+
+bool ThreadPool::popTask(unsigned int idx, Task& task)
+{
+	WorkQueue& queue = *_queues[idx];
+
+	std::lock_guard<std::mutex> lock(queue.mutex);
+
+	if (queue.tasks.empty()) return false;
+
+	task = std::move(queue.tasks.back());
+	queue.tasks.pop_back();
+
+	_queued--;
+
+	return true;
+}
+
+bool ThreadPool::stealTask(unsigned int idx, Task& task)
+{
+	unsigned int count = (unsigned int)_queues.size();
+
+	unsigned int i;
+	for (i = 1; i <= count; ++i)
+	{
+		WorkQueue& queue = *_queues[(idx + i) % count];
+
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+
+			_queued--;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::runTask(Task& task)
+{
+	task();
+	task = nullptr;
+
+	if (--_pending == 0)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_workDone.notify_all();
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_running = false;
+	}
+
+	_workAvailable.notify_all();
+
+	for (std::thread& worker : _workers)
+		worker.join();
+}
@@ -0,0 +1,92 @@
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <functional>
+
+namespace engine
+{
+	namespace util
+	{
+		/**
+			Work stealing thread pool.
+
+			Each worker owns a task queue, takes work from the back of its own queue and steals from the
+			front of the other queues when it runs dry.
+		*/
+		class ThreadPool
+		{
+		public:
+
+			typedef std::function<void()> Task;
+
+			/**
+				Create a pool sized to the number of hardware threads
+			*/
+			ThreadPool();
+
+			/**
+				Create a pool with the specified number of worker threads
+			*/
+			ThreadPool(unsigned int threadCount);
+			~ThreadPool();
+
+			/**
+				Queue a task to be run by the workers
+			*/
+			void submit(const Task& task);
+
+			/**
+				Block until all submitted tasks have completed. The calling thread runs queued tasks while it waits
+			*/
+			void wait();
+
+			/**
+				@return the number of worker threads
+			*/
+			unsigned int getThreadCount() const;
+
+		private:
+
+			struct WorkQueue
+			{
+				std::deque<Task> tasks;
+				std::mutex       mutex;
+			};
+
+			std::vector<std::unique_ptr<WorkQueue>> _queues;
+			std::vector<std::thread>                _workers;
+
+			std::mutex              _mutex;
+			std::condition_variable _workAvailable;
+			std::condition_variable _workDone;
+
+			// number of tasks sitting in queues
+			std::atomic<int> _queued;
+			// number of tasks not yet completed
+			std::atomic<int> _pending;
+
+			std::atomic<unsigned int> _nextQueue;
+
+			bool _running;
+
+		private:
+
+			void workerLoop(unsigned int idx);
+
+			bool popTask(unsigned int idx, Task& task);
+			bool stealTask(unsigned int idx, Task& task);
+
+			void runTask(Task& task);
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,49 @@
+
+#include "TileRegionBuffer.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+
+using namespace engine;
+using namespace sgl;
+
+TileRegionBuffer::TileRegionBuffer() :
+	_ubo(0)
+{
+}
+
+void TileRegionBuffer::setRegions(const std::vector<Vector4>& regions)
+{
+	if (_ubo == 0)
+	{
+		glGenBuffers(1, &_ubo);
+
+		// the whole block is allocated once, regions beyond the atlas are never indexed
+		glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+		glBufferData(GL_UNIFORM_BUFFER, MAX_REGIONS * sizeof(Vector4), 0, GL_DYNAMIC_DRAW);
+	}
+	else
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, _ubo);
+	}
+
+	// a std140 vec4 array has a 16 byte stride, the same as Vector4
+	size_t count = std::min<size_t>(regions.size(), MAX_REGIONS);
+
+	if (count > 0)
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(Vector4), &regions[0].x);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void TileRegionBuffer::bind(unsigned int binding) const
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, _ubo);
+}
+
+TileRegionBuffer::~TileRegionBuffer()
+{
+	if (_ubo != 0)
+		glDeleteBuffers(1, &_ubo);
+}
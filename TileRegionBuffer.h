@@ -0,0 +1,44 @@
+
+#ifndef TILEREGIONBUFFER_H
+#define TILEREGIONBUFFER_H
+
+#include <SGL/Math/Vector4.h>
+
+#include <vector>
+
+namespace engine
+{
+	/**
+		Uniform buffer holding the atlas tile regions read by the packed geometry pass.
+
+		The regions are the std140 block TileRegions { vec4 regions[MAX_REGIONS]; }. A uniform array of that
+		size in the default block would take the whole vertex uniform budget GL 3.3 guarantees, a uniform
+		buffer has room for it
+	*/
+	class TileRegionBuffer
+	{
+	public:
+
+		// maximum number of atlas regions addressable by the packed geometry pass
+		static const unsigned int MAX_REGIONS = 256;
+
+		TileRegionBuffer();
+		~TileRegionBuffer();
+
+		/**
+			Upload the regions as (u, v, width, height). Regions past MAX_REGIONS are dropped
+		*/
+		void setRegions(const std::vector<sgl::Vector4>& regions);
+
+		/**
+			Bind the buffer to uniform buffer binding point binding
+		*/
+		void bind(unsigned int binding) const;
+
+	private:
+
+		unsigned int _ubo;
+	};
+}
+
+#endif
@@ -0,0 +1,200 @@
+
+#include "ViewFrustum.h"
+
+#include <cmath>
+#include <algorithm>
+#include <cfloat>
+
+using namespace engine;
+using namespace sgl;
+
+ViewFrustum::ViewFrustum() :
+	_tanH(1),
+	_tanV(1),
+	_near(0.1f),
+	_far(100)
+{
+	int i;
+	for (i = 0; i < 6; ++i)
+		_planes[i].d = 0;
+}
+
+void ViewFrustum::construct(float fov, float ratio, float nearPlane, float farPlane,
+	const Vector3& position, const Vector3& direction, const Vector3& right, const Vector3& up)
+{
+	// slope of the side planes away from the view direction
+	float tanV = std::tan(fov * 3.14159265f / 360.0f);
+	float tanH = tanV * ratio;
+
+	_position  = position;
+	_direction = direction;
+	_right     = right;
+	_up        = up;
+
+	_tanH = tanH;
+	_tanV = tanV;
+	_near = nearPlane;
+	_far  = farPlane;
+
+	setPlane(0, direction, position + direction * nearPlane);
+	setPlane(1, -direction, position + direction * farPlane);
+
+	// the side planes all pass through the eye
+	setPlane(2, direction * tanH + right, position);
+	setPlane(3, direction * tanH - right, position);
+	setPlane(4, direction * tanV + up, position);
+	setPlane(5, direction * tanV - up, position);
+}
+
+ViewFrustum::Side ViewFrustum::checkBox(const Vector3& min, const Vector3& max) const
+{
+	Side side = Side::INSIDE;
+
+	int i;
+	for (i = 0; i < 6; ++i)
+	{
+		const Plane& plane = _planes[i];
+
+		// the corners furthest along and furthest against the plane normal
+		Vector3 positive(
+			plane.normal.x >= 0 ? max.x : min.x,
+			plane.normal.y >= 0 ? max.y : min.y,
+			plane.normal.z >= 0 ? max.z : min.z
+		);
+
+		Vector3 negative(
+			plane.normal.x >= 0 ? min.x : max.x,
+			plane.normal.y >= 0 ? min.y : max.y,
+			plane.normal.z >= 0 ? min.z : max.z
+		);
+
+		if (plane.normal.dot(positive) + plane.d < 0) return Side::OUTSIDE;
+
+		if (plane.normal.dot(negative) + plane.d < 0) side = Side::INTERSECT;
+	}
+
+	return side;
+}
+
+ViewFrustum::Side ViewFrustum::checkSphere(const Vector3& center, float radius) const
+{
+	Side side = Side::INSIDE;
+
+	int i;
+	for (i = 0; i < 6; ++i)
+	{
+		float distance = _planes[i].normal.dot(center) + _planes[i].d;
+
+		if (distance < -radius) return Side::OUTSIDE;
+
+		if (distance < radius) side = Side::INTERSECT;
+	}
+
+	return side;
+}
+
+ViewFrustum::Side ViewFrustum::checkBox(const Vector3& min, const Vector3& max, float distance, float angle) const
+{
+	// a turn by angle moves a point r away from the eye at most r * angle, and the move adds distance to r.
+	// Growing the box by the largest shift over its corners covers every frustum within the bounds
+	float margin = distance + angle * (getReach(min, max) + distance);
+
+	Vector3 grow(margin, margin, margin);
+
+	return checkBox(min - grow, max + grow);
+}
+
+ViewFrustum::Side ViewFrustum::checkBox(const Vector3& min, const Vector3& max, float& clearance) const
+{
+	// the least depth of the box inside the planes, or the most distance outside one of them
+	float inside  = FLT_MAX;
+	float outside = 0;
+
+	int i;
+	for (i = 0; i < 6; ++i)
+	{
+		const Plane& plane = _planes[i];
+
+		Vector3 positive(
+			plane.normal.x >= 0 ? max.x : min.x,
+			plane.normal.y >= 0 ? max.y : min.y,
+			plane.normal.z >= 0 ? max.z : min.z
+		);
+
+		Vector3 negative(
+			plane.normal.x >= 0 ? min.x : max.x,
+			plane.normal.y >= 0 ? min.y : max.y,
+			plane.normal.z >= 0 ? min.z : max.z
+		);
+
+		outside = std::max(outside, -(plane.normal.dot(positive) + plane.d));
+		inside  = std::min(inside, plane.normal.dot(negative) + plane.d);
+	}
+
+	if (outside > 0)
+	{
+		clearance = outside;
+		return Side::OUTSIDE;
+	}
+
+	if (inside >= 0)
+	{
+		clearance = inside;
+		return Side::INSIDE;
+	}
+
+	clearance = 0;
+	return Side::INTERSECT;
+}
+
+float ViewFrustum::getReach(const Vector3& min, const Vector3& max) const
+{
+	float reach = 0;
+
+	int i;
+	for (i = 0; i < 8; ++i)
+	{
+		Vector3 corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+
+		reach = std::max(reach, (corner - _position).length());
+	}
+
+	return reach;
+}
+
+bool ViewFrustum::getMotion(const ViewFrustum& from, float& distance, float& angle) const
+{
+	if (_tanH != from._tanH || _tanV != from._tanV || _near != from._near || _far != from._far) return false;
+
+	distance = (_position - from._position).length();
+
+	// angle of the rotation between the two camera bases from the trace of its matrix
+	float c = (_direction.dot(from._direction) + _right.dot(from._right) + _up.dot(from._up) - 1) / 2;
+
+	angle = std::acos(std::max(-1.0f, std::min(1.0f, c)));
+
+	return true;
+}
+
+bool ViewFrustum::project(const Vector3& p, float& x, float& y, float& depth) const
+{
+	Vector3 v = p - _position;
+
+	depth = v.dot(_direction);
+
+	if (depth < _near) return false;
+
+	x = v.dot(_right) / (depth * _tanH);
+	y = v.dot(_up)    / (depth * _tanV);
+
+	return true;
+}
+
+void ViewFrustum::setPlane(int i, const Vector3& normal, const Vector3& point)
+{
+	Vector3 n = normal;
+	n.normalize();
+
+	_planes[i].normal = n;
+	_planes[i].d      = -n.dot(point);
+}
@@ -0,0 +1,103 @@
+
+#ifndef VIEWFRUSTUM_H
+#define VIEWFRUSTUM_H
+
+#include <SGL/Math/Vector3.h>
+
+namespace engine
+{
+	/**
+		The six planes bounding the view of a perspective camera, with normals pointing inside.
+
+		Used to cull boxes, which bound chunks much tighter than the spheres the math library's frustum tests
+	*/
+	class ViewFrustum
+	{
+	public:
+
+		enum class Side
+		{
+			INSIDE,
+			OUTSIDE,
+			INTERSECT
+		};
+
+		ViewFrustum();
+
+		/**
+			fov   - vertical field of view in degrees
+			ratio - width over height of the view
+
+			direction, right and up must be unit length and perpendicular to each other
+		*/
+		void construct(float fov, float ratio, float nearPlane, float farPlane,
+			const sgl::Vector3& position, const sgl::Vector3& direction, const sgl::Vector3& right, const sgl::Vector3& up);
+
+		/**
+			Test the axis aligned box from min to max against the frustum
+		*/
+		Side checkBox(const sgl::Vector3& min, const sgl::Vector3& max) const;
+
+		/**
+			Test the sphere around center against the frustum, the way chunks were culled before they had boxes
+		*/
+		Side checkSphere(const sgl::Vector3& center, float radius) const;
+
+		/**
+			Test the box against every frustum with the same projection whose camera moved at most distance and
+			turned at most angle radians from this one. OUTSIDE means the box is outside all of them
+		*/
+		Side checkBox(const sgl::Vector3& min, const sgl::Vector3& max, float distance, float angle) const;
+
+		/**
+			Test the box and get how far its corners are from changing the result. An INSIDE box is at least
+			clearance inside every plane and an OUTSIDE box at least clearance outside one, INTERSECT gives 0
+		*/
+		Side checkBox(const sgl::Vector3& min, const sgl::Vector3& max, float& clearance) const;
+
+		/**
+			@return the distance from the eye to the furthest corner of the box
+		*/
+		float getReach(const sgl::Vector3& min, const sgl::Vector3& max) const;
+
+		/**
+			Get how far the camera moved and how many radians it turned since from. Returns false when the
+			projections differ, the frustums aren't related by a move and turn
+		*/
+		bool getMotion(const ViewFrustum& from, float& distance, float& angle) const;
+
+		/**
+			Project point p onto the view. x and y are in [-1, 1] over the view and depth is the distance along
+			the view direction. Returns false when p is closer than the near plane
+		*/
+		bool project(const sgl::Vector3& p, float& x, float& y, float& depth) const;
+
+	private:
+
+		struct Plane
+		{
+			sgl::Vector3 normal;
+			float        d;      // points p on the plane satisfy normal . p + d = 0
+		};
+
+		// near, far, left, right, bottom, top
+		Plane _planes[6];
+
+		// camera the planes were made from
+		sgl::Vector3 _position;
+		sgl::Vector3 _direction;
+		sgl::Vector3 _right;
+		sgl::Vector3 _up;
+
+		float _tanH;
+		float _tanV;
+		float _near;
+		float _far;
+
+	private:
+
+		void setPlane(int i, const sgl::Vector3& normal, const sgl::Vector3& point);
+	};
+}
+
+#endif
@@ -24,13 +24,18 @@ VoxelEngine::VoxelEngine() : _camera(Vector3(10, 45, 10)), _logger("engine.log")
 
 void VoxelEngine::update()
 {
+	std::set<ChunkManager*>::iterator iter;
+
+	// the visible chunks are sorted by distance to the view position
+	for (iter = _chunkManagers.begin(); iter != _chunkManagers.end(); ++iter)
+		(*iter)->setViewPosition(_camera.getPosition());
+
 	if (_updateChunks)
 	{
 		updateChunkManagersVisibility(_camera.getFrustum());
 		_updateChunks = false;
 	}
 
-	std::set<ChunkManager*>::iterator iter;
 	for (iter = _chunkManagers.begin(); iter != _chunkManagers.end(); ++iter)
 	{
 		ChunkManager* manager = (*iter);
@@ -65,7 +70,7 @@ void VoxelEngine::addChunkManager(ChunkManager* manager)
 	_chunkManagers.insert(manager);
 }
 
-void VoxelEngine::updateChunkManagersVisibility(Frustum& frustum)
+void VoxelEngine::updateChunkManagersVisibility(ViewFrustum& frustum)
 {
 	std::set<ChunkManager*>::iterator iter;
 	for (iter = _chunkManagers.begin(); iter != _chunkManagers.end(); ++iter)
@@ -250,6 +255,11 @@ ConfigReader& VoxelEngine::getConfig()
 	return _config;
 }
 
+util::ThreadPool& VoxelEngine::getThreadPool()
+{
+	return _threadPool;
+}
+
 VoxelEngine* VoxelEngine::getEngine()
 {
 	static VoxelEngine engine;
@@ -11,6 +11,7 @@
 #include "Logger.h"
 #include "CommandLine.h"
 #include "ConfigReader.h"
+#include "ThreadPool.h"
 
 #include <SGL/Util/DebugRenderer.h>
 #include <SGL/Graphics/SpriteBatch.h>
@@ -56,6 +57,8 @@ namespace engine
 
 		ConfigReader& getConfig();
 
+		util::ThreadPool& getThreadPool();
+
 		/**
 			Return the instance of the voxel engine
 		*/
@@ -96,9 +99,12 @@ namespace engine
 		//
 		util::Logger _logger;
 
+		//
+		util::ThreadPool _threadPool;
+
 	private:
 
-		void updateChunkManagersVisibility(sgl::Frustum& frustum);
+		void updateChunkManagersVisibility(ViewFrustum& frustum);
 
 		void initializeContext();
 
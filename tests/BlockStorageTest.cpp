@@ -0,0 +1,85 @@
+
+/**
+	Checks the memory used by palette compressed block storage against the flat block array it replaced.
+
+	A chunk worth of blocks is filled with one type, two types, sixteen types, and with sixteen types that are
+	then overwritten back to one. Every case has to read back the types written, use the expected bits per
+	block and take less memory than the flat array, whose Block held the type, the coordinates and six face
+	lights in 16 bytes. Links against BlockStorage. Returns non zero when a check fails
+*/
+
+#include "BlockStorage.h"
+
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstdio>
+
+using namespace engine;
+
+namespace
+{
+	const int SIZE  = 16;  // blocks per chunk axis, the engine default
+	const int COUNT = SIZE * SIZE * SIZE;
+
+	const unsigned int FLAT_BYTES = COUNT * 16;
+
+	int failures = 0;
+
+	void check(const char* name, BlockStorage& storage, const std::function<uint8_t(int)>& getType, int bits)
+	{
+		int mismatches = 0;
+
+		int i;
+		for (i = 0; i < COUNT; ++i)
+		{
+			if (storage.get(i) != getType(i))
+				++mismatches;
+		}
+
+		unsigned int bytes = storage.getMemoryUsage();
+
+		bool ok = (mismatches == 0 && storage.getBitsPerBlock() == bits && bytes < FLAT_BYTES);
+
+		printf("%-48s %s", name, ok ? "ok" : "FAILED");
+		printf(", %u bytes at %d bits per block, %u bytes flat, %d wrong types\n", bytes, storage.getBitsPerBlock(), FLAT_BYTES, mismatches);
+
+		if (!ok)
+			++failures;
+	}
+
+	void fill(BlockStorage& storage, const std::function<uint8_t(int)>& getType)
+	{
+		int i;
+		for (i = 0; i < COUNT; ++i)
+			storage.set(i, getType(i));
+	}
+}
+
+int main()
+{
+	std::function<uint8_t(int)> uniform = [](int i) { return (uint8_t)3; };
+
+	// stone below the surface and air above, the half way split of a terrain chunk
+	std::function<uint8_t(int)> twoTypes = [](int i) { return (uint8_t)((i / (SIZE * SIZE) < SIZE / 2) ? 3 : 0); };
+
+	// ores and variants of a mined out area, each block differs from its neighbors
+	std::function<uint8_t(int)> sixteenTypes = [](int i) { return (uint8_t)((i * 7) % 16); };
+
+	BlockStorage storage(COUNT);
+
+	fill(storage, uniform);
+	check("uniform chunk", storage, uniform, 0);
+
+	fill(storage, twoTypes);
+	check("two type chunk", storage, twoTypes, 1);
+
+	fill(storage, sixteenTypes);
+	check("sixteen type chunk", storage, sixteenTypes, 4);
+
+	// every block set back one at a time, the way a chunk is edited
+	fill(storage, uniform);
+	check("sixteen types collapsed back to uniform", storage, uniform, 0);
+
+	return failures == 0 ? 0 : 1;
+}
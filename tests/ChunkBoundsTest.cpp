@@ -0,0 +1,233 @@
+
+/**
+	Counts the chunks accepted by frustum culling on a flight over terrain, before and after chunks were culled
+	by the box around their geometry.
+
+	A fixed terrain of rolling hills with caves is meshed, then a camera flies over it. Every frame the chunks
+	whose sphere around the whole chunk crosses the frustum, as every chunk was culled before, are counted
+	against the chunks an octree walk of the geometry boxes accepts. The boxes have to accept fewer chunks and
+	only chunks the spheres accept. Links against ChunkOctree, ViewFrustum, Chunk, BlockStorage, ChunkMesh,
+	TileRegionBuffer, QuadIndexBuffer, LightEngine and ThreadPool, no GL context is needed as the meshes are
+	never uploaded. Returns non zero when a check fails
+*/
+
+#include "ChunkOctree.h"
+#include "ViewFrustum.h"
+#include "Chunk.h"
+
+#include <SGL/Math/Vector3.h>
+#include <SGL/Math/Vector4.h>
+#include <SGL/Math/Matrix4.h>
+#include <SGL/Math/Sphere.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace engine;
+using namespace sgl;
+
+namespace
+{
+	const int SIZE   = 16;  // blocks per chunk axis, the engine default
+	const int GRID_X = 24;
+	const int GRID_Y = 4;
+	const int GRID_Z = 24;
+
+	int failures = 0;
+
+	// grass over dirt over stone, with caves below the surface
+	int getTerrain(int x, int y, int z)
+	{
+		float height = 32 + 12 * std::sin(x * 0.05f) * std::cos(z * 0.07f) + 6 * std::sin((x + z) * 0.13f);
+
+		if (y > height) return 0;
+
+		if (std::sin(x * 0.2f) * std::sin(y * 0.3f) * std::sin(z * 0.25f) > 0.4f) return 0;
+
+		if (y + 1 > height) return 1;
+		if (y + 4 > height) return 2;
+
+		return 3;
+	}
+
+	struct World
+	{
+		std::vector<Chunk*> grid;
+		std::vector<Vector4> regions;
+		// the sphere around each whole chunk, as calculateBounds gave before the first build
+		std::vector<Sphere> spheres;
+		ChunkOctree octree;
+		Matrix4 transform;
+
+		World() :
+			regions(3, Vector4(0, 0, 1, 1))
+		{
+			transform.toTranslation(0, 0, 0);
+
+			int x, y, z;
+			for (x = 0; x < GRID_X; ++x)
+			{
+				for (y = 0; y < GRID_Y; ++y)
+				{
+					for (z = 0; z < GRID_Z; ++z)
+					{
+						Chunk* chunk = new Chunk(SIZE);
+						chunk->setLocation(x, y, z);
+						chunk->setTileRegions(&regions);
+
+						grid.push_back(chunk);
+					}
+				}
+			}
+
+			for (Chunk* chunk : grid)
+			{
+				Vector3 loc = chunk->getLocation();
+
+				x = (int)loc.x;
+				y = (int)loc.y;
+				z = (int)loc.z;
+
+				chunk->left   = getChunk(x - 1, y, z);
+				chunk->right  = getChunk(x + 1, y, z);
+				chunk->top    = getChunk(x, y + 1, z);
+				chunk->bottom = getChunk(x, y - 1, z);
+				chunk->near   = getChunk(x, y, z - 1);
+				chunk->far    = getChunk(x, y, z + 1);
+
+				fill(chunk, x, y, z);
+
+				chunk->calculateBounds(transform);
+				spheres.push_back(chunk->getBounds());
+			}
+
+			for (Chunk* chunk : grid)
+			{
+				chunk->takeSnapshot();
+				chunk->generateMesh();
+
+				chunk->calculateBounds(transform);
+				octree.insert(chunk);
+			}
+		}
+
+		~World()
+		{
+			for (Chunk* chunk : grid)
+				delete chunk;
+		}
+
+		Chunk* getChunk(int x, int y, int z)
+		{
+			if (x < 0 || y < 0 || z < 0 || x >= GRID_X || y >= GRID_Y || z >= GRID_Z) return nullptr;
+
+			return grid[(x * GRID_Y + y) * GRID_Z + z];
+		}
+
+		void fill(Chunk* chunk, int cx, int cy, int cz)
+		{
+			int x, y, z;
+			for (x = 0; x < SIZE; ++x)
+			{
+				for (y = 0; y < SIZE; ++y)
+				{
+					for (z = 0; z < SIZE; ++z)
+						chunk->setBlock(x, y, z, getTerrain(cx * SIZE + x, cy * SIZE + y, cz * SIZE + z));
+				}
+			}
+		}
+	};
+
+	ViewFrustum makeFrustum(const Vector3& position, float yaw, float pitch)
+	{
+		Vector3 direction(std::cos(pitch) * std::sin(yaw), std::sin(pitch), std::cos(pitch) * std::cos(yaw));
+
+		Vector3 right;
+		right.set(direction).cross(Vector3(0, 1, 0));
+		right.normalize();
+
+		Vector3 up;
+		up.set(right).cross(direction);
+		up.normalize();
+
+		ViewFrustum frustum;
+		frustum.construct(70.0f, 16.0f / 9.0f, 0.1f, 300.0f, position, direction, right, up);
+
+		return frustum;
+	}
+
+	void testFlythrough()
+	{
+		World world;
+
+		const int FRAMES = 200;
+
+		unsigned int before    = 0;
+		unsigned int after     = 0;
+		unsigned int unbounded = 0;  // accepted by a box but not by the sphere around its chunk
+
+		std::vector<Chunk*> visible;
+
+		int frame;
+		for (frame = 0; frame < FRAMES; ++frame)
+		{
+			float t = frame * 0.03f;
+
+			// a loop a little above the hills, looking ahead and down
+			float extent = GRID_X * SIZE * 2.0f;
+
+			Vector3 eye(extent / 2 + extent / 3 * std::sin(t), 100 + 20 * std::sin(t * 2.3f), extent / 2 + extent / 3 * std::cos(t));
+			float yaw   = t + 1.57f;
+			float pitch = -0.3f + 0.2f * std::sin(t * 1.7f);
+
+			ViewFrustum frustum = makeFrustum(eye, yaw, pitch);
+
+			size_t i;
+			for (i = 0; i < world.grid.size(); ++i)
+			{
+				if (frustum.checkSphere(world.spheres[i].center, world.spheres[i].radius) != ViewFrustum::Side::OUTSIDE)
+					++before;
+			}
+
+			visible.clear();
+			world.octree.cull(frustum, 0, 0, visible);
+
+			after += (unsigned int)visible.size();
+
+			for (Chunk* chunk : visible)
+			{
+				Vector3 loc = chunk->getLocation();
+				Sphere& sphere = world.spheres[((int)loc.x * GRID_Y + (int)loc.y) * GRID_Z + (int)loc.z];
+
+				if (frustum.checkSphere(sphere.center, sphere.radius) == ViewFrustum::Side::OUTSIDE)
+					++unbounded;
+			}
+		}
+
+		unsigned int empty = 0;
+
+		for (Chunk* chunk : world.grid)
+		{
+			if (!chunk->hasGeometry())
+				++empty;
+		}
+
+		bool ok = (after < before && unbounded == 0);
+
+		printf("%-48s %s", "geometry boxes accept fewer chunks", ok ? "ok" : "FAILED");
+		printf(", %u of %u chunks have no faces, per frame %.1f chunks accepted by spheres, %.1f by boxes\n", empty,
+			(unsigned int)world.grid.size(), (float)before / FRAMES, (float)after / FRAMES);
+
+		if (!ok)
+			++failures;
+	}
+}
+
+int main()
+{
+	testFlythrough();
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,336 @@
+
+/**
+	Checks that culling within the guard of the last octree walk gives the same chunks as a full walk.
+
+	A camera moves through a grid of chunks in small steps that stay within the guard and jumps that leave it,
+	while chunks are loaded, unloaded and rebuilt around it. Every frame the culler's list is compared with
+	the chunks a walk of the octree with no guard finds for the same frustum, and checked to be front to back.
+	Then the octree is compared with testing the box of every chunk on a grid of 64 chunks per axis, printing
+	the boxes each tests and the time they take per frame. Links against ChunkCuller, ChunkOctree, ViewFrustum,
+	Chunk, BlockStorage, ChunkMesh, TileRegionBuffer, QuadIndexBuffer, LightEngine and ThreadPool, no GL
+	context is needed as the chunks are never meshed. Returns non zero when a check fails
+*/
+
+#include "ChunkCuller.h"
+#include "ChunkOctree.h"
+#include "ViewFrustum.h"
+#include "Chunk.h"
+
+#include <SGL/Math/Vector3.h>
+#include <SGL/Math/Matrix4.h>
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+using namespace engine;
+using namespace sgl;
+
+namespace
+{
+	const int SIZE   = 4;   // blocks per chunk axis
+	const int GRID_X = 48;
+	const int GRID_Y = 4;
+	const int GRID_Z = 48;
+
+	int failures = 0;
+
+	uint64_t getKey(int x, int y, int z)
+	{
+		return ((uint64_t)x) | ((uint64_t)y << 16) | ((uint64_t)z << 32);
+	}
+
+	struct World
+	{
+		std::unordered_map<uint64_t, Chunk*> chunks;
+		ChunkOctree octree;
+		ChunkCuller culler;
+		Matrix4 transform;
+
+		World() :
+			culler(SIZE * 2.0f, 0.2f)
+		{
+			transform.toTranslation(0, 0, 0);
+		}
+
+		~World()
+		{
+			std::unordered_map<uint64_t, Chunk*>::iterator iter;
+			for (iter = chunks.begin(); iter != chunks.end(); ++iter)
+				delete iter->second;
+		}
+
+		void load(int x, int y, int z)
+		{
+			uint64_t key = getKey(x, y, z);
+
+			if (chunks.find(key) != chunks.end()) return;
+
+			Chunk* chunk = new Chunk(SIZE);
+			chunk->setLocation(x, y, z);
+			chunk->calculateBounds(transform);
+
+			chunks[key] = chunk;
+
+			octree.insert(chunk);
+			culler.update(chunk);
+		}
+
+		void unload(int x, int y, int z)
+		{
+			std::unordered_map<uint64_t, Chunk*>::iterator iter = chunks.find(getKey(x, y, z));
+
+			if (iter == chunks.end()) return;
+
+			octree.remove(iter->second);
+			culler.remove(iter->second);
+
+			delete iter->second;
+			chunks.erase(iter);
+		}
+
+		// record a chunk again as a mesh rebuild does
+		void rebuild(int x, int y, int z)
+		{
+			std::unordered_map<uint64_t, Chunk*>::iterator iter = chunks.find(getKey(x, y, z));
+
+			if (iter == chunks.end()) return;
+
+			octree.update(iter->second);
+			culler.update(iter->second);
+		}
+	};
+
+	ViewFrustum makeFrustum(const Vector3& position, float yaw, float pitch)
+	{
+		Vector3 direction(std::cos(pitch) * std::sin(yaw), std::sin(pitch), std::cos(pitch) * std::cos(yaw));
+
+		Vector3 right;
+		right.set(direction).cross(Vector3(0, 1, 0));
+		right.normalize();
+
+		Vector3 up;
+		up.set(right).cross(direction);
+		up.normalize();
+
+		ViewFrustum frustum;
+		frustum.construct(70.0f, 16.0f / 9.0f, 0.1f, 160.0f, position, direction, right, up);
+
+		return frustum;
+	}
+
+	// every chunk the unguarded walk finds is in visible once, and visible is front to back from eye
+	unsigned int countDifferences(World& world, const ViewFrustum& frustum, const Vector3& eye, std::vector<Chunk*>& visible)
+	{
+		std::vector<Chunk*> expected;
+		world.octree.cull(frustum, 0, 0, expected);
+
+		unsigned int differences = 0;
+
+		size_t i;
+		for (i = 1; i < visible.size(); ++i)
+		{
+			Vector3 a = visible[i - 1]->getBounds().center - eye;
+			Vector3 b = visible[i]->getBounds().center - eye;
+
+			if (a.dot(a) > b.dot(b))
+				++differences;
+		}
+
+		std::vector<Chunk*> found = visible;
+
+		std::sort(expected.begin(), expected.end());
+		std::sort(found.begin(), found.end());
+
+		std::vector<Chunk*> missing;
+		std::set_symmetric_difference(expected.begin(), expected.end(), found.begin(), found.end(), std::back_inserter(missing));
+
+		return differences + (unsigned int)missing.size();
+	}
+
+	void testCameraPath()
+	{
+		World world;
+
+		int x, y, z;
+		for (x = 0; x < GRID_X; ++x)
+		{
+			for (y = 0; y < GRID_Y; ++y)
+			{
+				for (z = 0; z < GRID_Z; ++z)
+					world.load(x, y, z);
+			}
+		}
+
+		const int FRAMES = 600;
+
+		unsigned int differences = 0;
+		unsigned int tested      = 0;
+		unsigned int candidates  = 0;
+
+		std::vector<Chunk*> visible;
+
+		uint32_t seed = 12345;
+
+		int frame;
+		for (frame = 0; frame < FRAMES; ++frame)
+		{
+			float t = frame * 0.02f;
+
+			// a slow loop over the grid with a jump every 100 frames, shaking back and forth so the view also
+			// moves back toward the frustum of the last walk
+			float shake = std::sin(frame * 0.9f);
+
+			Vector3 eye(192 + 120 * std::sin(t * 0.5f) + 3 * shake, 12 + 4 * std::sin(t * 1.3f), 192 + 120 * std::cos(t * 0.4f));
+			float yaw   = t * 0.8f + (frame / 100) * 2.0f + 0.05f * shake;
+			float pitch = 0.3f * std::sin(t * 0.7f);
+
+			// unload, reload and rebuild a few chunks every frame, as streaming and edits do
+			int i;
+			for (i = 0; i < 12; ++i)
+			{
+				seed = seed * 1664525 + 1013904223;
+
+				x = (seed >> 8) % GRID_X;
+				y = (seed >> 16) % GRID_Y;
+				z = (seed >> 20) % GRID_Z;
+
+				if (i % 3 == 2)
+					world.rebuild(x, y, z);
+				else if (seed & 1)
+					world.unload(x, y, z);
+				else
+					world.load(x, y, z);
+			}
+
+			ViewFrustum frustum = makeFrustum(eye, yaw, pitch);
+
+			world.culler.cull(world.octree, frustum, eye, visible);
+
+			differences += countDifferences(world, frustum, eye, visible);
+
+			tested     += world.culler.getChunksTested();
+			candidates += (unsigned int)visible.size();
+		}
+
+		unsigned int walks = world.culler.getFullCullCount();
+
+		printf("%-48s %s", "guarded culls match a full walk", differences == 0 ? "ok\n" : "FAILED");
+
+		if (differences != 0)
+		{
+			printf(", %u chunks differ\n", differences);
+			++failures;
+		}
+
+		// the guard has to be used, or the check above only compares walks
+		printf("%-48s %s", "the octree is walked on few frames", (walks > 1 && walks < FRAMES / 4) ? "ok" : "FAILED");
+		printf(", %u walks, %u chunk tests for %u visible chunks\n", walks, tested, candidates);
+
+		if (walks <= 1 || walks >= FRAMES / 4)
+			++failures;
+	}
+
+	// the octree against testing the box of every chunk, on a grid of 64 chunks per axis seen from inside and
+	// from above. Both have to find the same chunks and the octree has to test fewer boxes
+	void testFlatList()
+	{
+		const int GRID = 64;
+
+		World world;
+
+		int x, y, z;
+		for (x = 0; x < GRID; ++x)
+		{
+			for (y = 0; y < GRID; ++y)
+			{
+				for (z = 0; z < GRID; ++z)
+					world.load(x, y, z);
+			}
+		}
+
+		std::vector<Chunk*> chunks;
+
+		std::unordered_map<uint64_t, Chunk*>::iterator iter;
+		for (iter = world.chunks.begin(); iter != world.chunks.end(); ++iter)
+			chunks.push_back(iter->second);
+
+		const int FRAMES = 100;
+
+		unsigned int differences = 0;
+		unsigned int nodes       = 0;
+		unsigned int visible     = 0;
+
+		double treeTime = 0;
+		double flatTime = 0;
+
+		std::vector<Chunk*> tree;
+		std::vector<Chunk*> flat;
+
+		int frame;
+		for (frame = 0; frame < FRAMES; ++frame)
+		{
+			float t = frame * 0.1f;
+
+			// half the frames inside the grid turning around, half above it looking down at it
+			float extent = GRID * SIZE * 2.0f;
+
+			Vector3 eye(extent / 2 + 100 * std::sin(t), (frame < FRAMES / 2) ? extent / 2 : extent + 40, extent / 2 + 100 * std::cos(t));
+			float pitch = (frame < FRAMES / 2) ? 0.2f * std::sin(t) : -1.2f;
+
+			ViewFrustum frustum = makeFrustum(eye, t, pitch);
+
+			tree.clear();
+			flat.clear();
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			world.octree.cull(frustum, 0, 0, tree);
+
+			std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+
+			for (Chunk* chunk : chunks)
+			{
+				if (frustum.checkBox(chunk->getBoundsMin(), chunk->getBoundsMax()) != ViewFrustum::Side::OUTSIDE)
+					flat.push_back(chunk);
+			}
+
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+			treeTime += std::chrono::duration<double, std::milli>(middle - start).count();
+			flatTime += std::chrono::duration<double, std::milli>(end - middle).count();
+
+			nodes   += world.octree.getNodesTested();
+			visible += (unsigned int)tree.size();
+
+			std::sort(tree.begin(), tree.end());
+			std::sort(flat.begin(), flat.end());
+
+			if (tree != flat)
+				++differences;
+		}
+
+		unsigned int flatTests = FRAMES * (unsigned int)chunks.size();
+
+		bool ok = (differences == 0 && nodes < flatTests);
+
+		printf("%-48s %s", "octree culls match testing every chunk", ok ? "ok" : "FAILED");
+		printf(", %u chunks, per frame %u visible, %u nodes tested in %.3f ms, %u chunks tested in %.3f ms\n",
+			(unsigned int)chunks.size(), visible / FRAMES, nodes / FRAMES, treeTime / FRAMES, flatTests / FRAMES, flatTime / FRAMES);
+
+		if (!ok)
+			++failures;
+	}
+}
+
+int main()
+{
+	testCameraPath();
+	testFlatList();
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,782 @@
+
+/**
+	Checks that light spread by the light engine doesn't depend on how the changes were split into fills.
+
+	A world lit one edit at a time has to end up with the same light values as the same final world lit in a
+	single fill from scratch, and chunk groups lit in parallel the same as one serial fill. A chunk generated
+	with a cave in a roof over lit columns has to leave them dark the same way. Also times torches
+	placed through a cave system and prints the nodes processed per second, then compares the memory and fill
+	time of the two light models, per voxel light has to take less memory. Links against Chunk,
+	BlockStorage, ChunkMesh, TileRegionBuffer, QuadIndexBuffer, LightEngine and ThreadPool, no GL context is
+	needed as the chunks are never meshed. Returns non zero when a check fails
+*/
+
+#include "Chunk.h"
+#include "LightEngine.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+using namespace engine;
+
+namespace
+{
+	struct Source
+	{
+		int x, y, z;
+		int r, g, b;
+	};
+
+	// chunk grid with every chunk resident and linked to its neighbors
+	struct World
+	{
+		int size;    // blocks per chunk axis
+		int chunks;  // chunks per axis
+		int slots;   // light values per block
+		std::vector<Chunk*> grid;
+
+		World(LightModel model, int chunks, int size) :
+			size(size),
+			chunks(chunks),
+			slots((model == LightModel::PER_VOXEL) ? 1 : 6)
+		{
+			int x, y, z;
+			for (x = 0; x < chunks; ++x)
+			{
+				for (y = 0; y < chunks; ++y)
+				{
+					for (z = 0; z < chunks; ++z)
+					{
+						Chunk* chunk = new Chunk(size);
+						chunk->setLightModel(model);
+						chunk->setLocation(x, y, z);
+
+						grid.push_back(chunk);
+					}
+				}
+			}
+
+			for (x = 0; x < chunks; ++x)
+			{
+				for (y = 0; y < chunks; ++y)
+				{
+					for (z = 0; z < chunks; ++z)
+					{
+						Chunk* chunk = getChunk(x, y, z);
+
+						chunk->left   = getChunk(x - 1, y, z);
+						chunk->right  = getChunk(x + 1, y, z);
+						chunk->top    = getChunk(x, y + 1, z);
+						chunk->bottom = getChunk(x, y - 1, z);
+						chunk->near   = getChunk(x, y, z - 1);
+						chunk->far    = getChunk(x, y, z + 1);
+					}
+				}
+			}
+		}
+
+		~World()
+		{
+			for (Chunk* chunk : grid)
+				delete chunk;
+		}
+
+		Chunk* getChunk(int x, int y, int z)
+		{
+			if (x < 0 || y < 0 || z < 0 || x >= chunks || y >= chunks || z >= chunks) return nullptr;
+
+			return grid[(x * chunks + y) * chunks + z];
+		}
+
+		// swap chunk (x, y, z) for an empty and unlit one, as a chunk unloaded and created again
+		Chunk* replaceChunk(int x, int y, int z)
+		{
+			Chunk*& slot = grid[(x * chunks + y) * chunks + z];
+			Chunk* old = slot;
+
+			Chunk* chunk = new Chunk(size);
+			chunk->setLightModel(old->getLightModel());
+			chunk->setLocation(x, y, z);
+
+			chunk->left   = old->left;
+			chunk->right  = old->right;
+			chunk->top    = old->top;
+			chunk->bottom = old->bottom;
+			chunk->near   = old->near;
+			chunk->far    = old->far;
+
+			if (chunk->left)   chunk->left->right  = chunk;
+			if (chunk->right)  chunk->right->left  = chunk;
+			if (chunk->top)    chunk->top->bottom  = chunk;
+			if (chunk->bottom) chunk->bottom->top  = chunk;
+			if (chunk->near)   chunk->near->far    = chunk;
+			if (chunk->far)    chunk->far->near    = chunk;
+
+			delete old;
+			slot = chunk;
+
+			return chunk;
+		}
+
+		Chunk* getBlockChunk(int x, int y, int z)
+		{
+			return getChunk(x / size, y / size, z / size);
+		}
+
+		void setBlock(int x, int y, int z, int t)
+		{
+			getBlockChunk(x, y, z)->setBlock(x % size, y % size, z % size, t);
+		}
+
+		void addSource(const Source& source)
+		{
+			getBlockChunk(source.x, source.y, source.z)->setLightSource(source.x % size, source.y % size, source.z % size, source.r, source.g, source.b);
+		}
+
+		void removeSource(const Source& source)
+		{
+			getBlockChunk(source.x, source.y, source.z)->removeLight(source.x % size, source.y % size, source.z % size);
+		}
+
+		// queue the changes of chunk into engine
+		static bool addChunk(LightEngine& engine, Chunk* chunk)
+		{
+			if (chunk->getPendingLights().empty() && chunk->getLightRemovalList().empty()) return false;
+
+			engine.addChunk(*chunk);
+			return true;
+		}
+
+		// chunks with changes waiting for the light engine
+		std::vector<Chunk*> getChangedChunks()
+		{
+			std::vector<Chunk*> changed;
+
+			for (Chunk* chunk : grid)
+			{
+				if (!chunk->getPendingLights().empty() || !chunk->getLightRemovalList().empty())
+					changed.push_back(chunk);
+			}
+
+			return changed;
+		}
+
+		// spread the changes the way the chunk manager does with parallel lighting, sky light serially
+		// before the block light of the chunk groups
+		void updateParallel(LightEngine& engine, std::vector<LightEngine>& workers, util::ThreadPool& pool)
+		{
+			engine.spread();
+
+			LightEngine::spreadGroups(getChangedChunks(), workers, pool);
+
+			clearChanged(engine);
+
+			for (LightEngine& worker : workers)
+				clearChanged(worker);
+		}
+
+		// give the air blocks of every column above its first solid block full sky light
+		void lightSky(LightEngine& engine)
+		{
+			int extent = chunks * size;
+
+			int x, y, z;
+			for (x = 0; x < extent; ++x)
+			{
+				for (z = 0; z < extent; ++z)
+				{
+					for (y = extent - 1; y >= 0; --y)
+					{
+						Chunk* chunk = getBlockChunk(x, y, z);
+
+						if (chunk->getBlock(x % size, y % size, z % size).t != 0) break;
+
+						engine.setSkyLight(*chunk, x % size, y % size, z % size);
+					}
+				}
+			}
+		}
+
+		static void clearChanged(LightEngine& engine)
+		{
+			for (Chunk* chunk : engine.getChangedChunks())
+				chunk->setLightChanged(false);
+
+			engine.getChangedChunks().clear();
+		}
+
+		// spread every queued change in one fill
+		void update(LightEngine& engine)
+		{
+			for (Chunk* chunk : grid)
+				addChunk(engine, chunk);
+
+			engine.spread();
+			clearChanged(engine);
+		}
+
+		// spread the queued changes of each chunk in a fill of its own
+		void updateEachChunk(LightEngine& engine)
+		{
+			for (Chunk* chunk : grid)
+			{
+				if (!addChunk(engine, chunk)) continue;
+
+				engine.spread();
+				clearChanged(engine);
+			}
+		}
+	};
+
+	uint32_t nextRandom(uint32_t& state)
+	{
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	// fill the world with the same random blocks for the same seed, roughly a quarter of them solid
+	void generateBlocks(World& world, uint32_t seed)
+	{
+		int extent = world.chunks * world.size;
+
+		int x, y, z;
+		for (x = 0; x < extent; ++x)
+		{
+			for (y = 0; y < extent; ++y)
+			{
+				for (z = 0; z < extent; ++z)
+				{
+					if (nextRandom(seed) % 4 == 0)
+						world.setBlock(x, y, z, 1 + nextRandom(seed) % 3);
+				}
+			}
+		}
+	}
+
+	std::vector<Source> generateSources(int count, int extent, uint32_t seed)
+	{
+		std::vector<Source> sources;
+
+		int i;
+		for (i = 0; i < count; ++i)
+		{
+			Source source;
+			source.x = nextRandom(seed) % extent;
+			source.y = nextRandom(seed) % extent;
+			source.z = nextRandom(seed) % extent;
+			source.r = nextRandom(seed) % 16;
+			source.g = nextRandom(seed) % 16;
+			source.b = 8 + nextRandom(seed) % 8;
+
+			sources.push_back(source);
+		}
+
+		return sources;
+	}
+
+	// number of light values that differ between two worlds of the same shape
+	unsigned int countDifferences(World& a, World& b)
+	{
+		unsigned int differences = 0;
+		int blocks = a.size * a.size * a.size;
+
+		size_t c;
+		for (c = 0; c < a.grid.size(); ++c)
+		{
+			int idx, slot;
+			for (idx = 0; idx < blocks; ++idx)
+			{
+				for (slot = 0; slot < a.slots; ++slot)
+				{
+					if (a.grid[c]->getLight(idx, static_cast<BlockFace>(slot)) != b.grid[c]->getLight(idx, static_cast<BlockFace>(slot)))
+						++differences;
+				}
+			}
+		}
+
+		return differences;
+	}
+
+	int failures = 0;
+
+	void check(const char* name, LightModel model, World& world, World& expected)
+	{
+		unsigned int differences = countDifferences(world, expected);
+
+		printf("%-48s %-9s %s", name, (model == LightModel::PER_VOXEL) ? "per voxel" : "per face", differences == 0 ? "ok\n" : "FAILED");
+
+		if (differences != 0)
+		{
+			printf(", %u light values differ\n", differences);
+			++failures;
+		}
+	}
+
+	void testSources(LightModel model)
+	{
+		const int CHUNKS = 3;
+		const int SIZE   = 16;
+
+		std::vector<Source> sources = generateSources(12, CHUNKS * SIZE, 7);
+
+		LightEngine engine(model);
+
+		World scratch(model, CHUNKS, SIZE);
+		generateBlocks(scratch, 1);
+
+		for (const Source& source : sources)
+			scratch.addSource(source);
+
+		scratch.update(engine);
+
+		// a fill per source
+		{
+			World world(model, CHUNKS, SIZE);
+			generateBlocks(world, 1);
+
+			for (const Source& source : sources)
+			{
+				world.addSource(source);
+				world.update(engine);
+			}
+
+			check("one fill per source", model, world, scratch);
+		}
+
+		// sources recorded before the fills of other chunks run, as when chunk groups are lit one after another
+		{
+			World world(model, CHUNKS, SIZE);
+			generateBlocks(world, 1);
+
+			for (const Source& source : sources)
+				world.addSource(source);
+
+			world.updateEachChunk(engine);
+
+			check("one fill per chunk", model, world, scratch);
+		}
+
+		// two colored sources 12 blocks apart lit in two fills
+		{
+			Source red   = { 10, 20, 20, 15, 0, 0 };
+			Source green = { 22, 20, 20, 0, 15, 0 };
+
+			World once(model, CHUNKS, SIZE);
+			once.addSource(red);
+			once.addSource(green);
+			once.update(engine);
+
+			World twice(model, CHUNKS, SIZE);
+			twice.addSource(red);
+			twice.addSource(green);
+			twice.updateEachChunk(engine);
+
+			check("two sources in two fills", model, twice, once);
+		}
+	}
+
+	void testRemoval(LightModel model)
+	{
+		const int CHUNKS = 3;
+		const int SIZE   = 16;
+
+		std::vector<Source> sources = generateSources(12, CHUNKS * SIZE, 11);
+
+		LightEngine engine(model);
+
+		// the world lit from scratch with every other source
+		World scratch(model, CHUNKS, SIZE);
+		generateBlocks(scratch, 2);
+
+		size_t i;
+		for (i = 1; i < sources.size(); i += 2)
+			scratch.addSource(sources[i]);
+
+		scratch.update(engine);
+
+		// removed in one fill
+		{
+			World world(model, CHUNKS, SIZE);
+			generateBlocks(world, 2);
+
+			for (const Source& source : sources)
+				world.addSource(source);
+
+			world.update(engine);
+
+			for (i = 0; i < sources.size(); i += 2)
+				world.removeSource(sources[i]);
+
+			world.update(engine);
+
+			check("remove sources in one fill", model, world, scratch);
+		}
+
+		// removed one fill at a time
+		{
+			World world(model, CHUNKS, SIZE);
+			generateBlocks(world, 2);
+
+			for (const Source& source : sources)
+				world.addSource(source);
+
+			world.update(engine);
+
+			for (i = 0; i < sources.size(); i += 2)
+			{
+				world.removeSource(sources[i]);
+				world.update(engine);
+			}
+
+			check("remove sources one fill at a time", model, world, scratch);
+		}
+
+		// two overlapping sources, one removed
+		{
+			Source red  = { 20, 20, 20, 15, 0, 4 };
+			Source blue = { 24, 21, 20, 0, 3, 15 };
+
+			World alone(model, CHUNKS, SIZE);
+			alone.addSource(red);
+			alone.update(engine);
+
+			World world(model, CHUNKS, SIZE);
+			world.addSource(red);
+			world.addSource(blue);
+			world.update(engine);
+
+			world.removeSource(blue);
+			world.update(engine);
+
+			check("remove one of two overlapping sources", model, world, alone);
+		}
+	}
+
+	void testDigging(LightModel model)
+	{
+		const int CHUNKS = 3;
+		const int SIZE   = 16;
+
+		std::vector<Source> sources = generateSources(8, CHUNKS * SIZE, 5);
+		std::vector<Source> holes   = generateSources(200, CHUNKS * SIZE, 13);
+
+		LightEngine engine(model);
+
+		World scratch(model, CHUNKS, SIZE);
+		generateBlocks(scratch, 3);
+
+		for (const Source& hole : holes)
+			scratch.setBlock(hole.x, hole.y, hole.z, 0);
+
+		for (const Source& source : sources)
+			scratch.addSource(source);
+
+		scratch.update(engine);
+
+		World world(model, CHUNKS, SIZE);
+		generateBlocks(world, 3);
+
+		for (const Source& source : sources)
+			world.addSource(source);
+
+		world.update(engine);
+
+		// light flows into the opened blocks
+		for (const Source& hole : holes)
+			world.setBlock(hole.x, hole.y, hole.z, 0);
+
+		world.update(engine);
+
+		check("dig blocks after lighting", model, world, scratch);
+	}
+
+	void testParallel(LightModel model)
+	{
+		const int CHUNKS = 4;
+		const int SIZE   = 16;
+
+		std::vector<Source> sources = generateSources(40, CHUNKS * SIZE, 17);
+		std::vector<Source> holes   = generateSources(400, CHUNKS * SIZE, 19);
+
+		util::ThreadPool pool(4);
+
+		LightEngine serialEngine(model);
+		LightEngine parallelEngine(model);
+
+		std::vector<LightEngine> workers(pool.getThreadCount() + 1, LightEngine(model));
+
+		World serial(model, CHUNKS, SIZE);
+		World parallel(model, CHUNKS, SIZE);
+
+		generateBlocks(serial, 4);
+		generateBlocks(parallel, 4);
+
+		// first half of the sources along with the sky light
+		size_t i;
+		for (i = 0; i < sources.size() / 2; ++i)
+		{
+			serial.addSource(sources[i]);
+			parallel.addSource(sources[i]);
+		}
+
+		serial.lightSky(serialEngine);
+		parallel.lightSky(parallelEngine);
+
+		serial.update(serialEngine);
+		parallel.updateParallel(parallelEngine, workers, pool);
+
+		check("parallel groups add sources", model, parallel, serial);
+
+		// the other half, removing some of the first
+		for (i = sources.size() / 2; i < sources.size(); ++i)
+		{
+			serial.addSource(sources[i]);
+			parallel.addSource(sources[i]);
+		}
+
+		for (i = 0; i < sources.size() / 2; i += 3)
+		{
+			serial.removeSource(sources[i]);
+			parallel.removeSource(sources[i]);
+		}
+
+		serial.update(serialEngine);
+		parallel.updateParallel(parallelEngine, workers, pool);
+
+		check("parallel groups add and remove sources", model, parallel, serial);
+
+		for (const Source& hole : holes)
+		{
+			serial.setBlock(hole.x, hole.y, hole.z, 0);
+			parallel.setBlock(hole.x, hole.y, hole.z, 0);
+		}
+
+		serial.update(serialEngine);
+		parallel.updateParallel(parallelEngine, workers, pool);
+
+		check("parallel groups dig blocks", model, parallel, serial);
+	}
+
+	const int FLOOR = 8;  // height of the stone floor under the generated chunk
+
+	void generateFloor(World& world)
+	{
+		int extent = world.chunks * world.size;
+
+		int x, y, z;
+		for (x = 0; x < extent; ++x)
+		{
+			for (y = 0; y < FLOOR; ++y)
+			{
+				for (z = 0; z < extent; ++z)
+					world.setBlock(x, y, z, 3);
+			}
+		}
+	}
+
+	// stone from four blocks above the bottom of the chunk, around a cave closed off on every side
+	void generateRoof(Chunk& chunk)
+	{
+		int size = chunk.getSize();
+
+		int x, y, z;
+		for (x = 0; x < size; ++x)
+		{
+			for (y = 4; y < size; ++y)
+			{
+				for (z = 0; z < size; ++z)
+				{
+					bool cave = (x >= 4 && x < size - 4 && y >= 8 && y < size - 4 && z >= 4 && z < size - 4);
+
+					if (!cave)
+						chunk.setBlock(x, y, z, 3);
+				}
+			}
+		}
+	}
+
+	// a chunk generated with a roof over columns lit through the space it fills is lit the way
+	// ChunkManager::updateStreaming lights it. Raising the sky heights of the columns first leaves the cave in
+	// the roof and the blocks under it dark from above, as in the same world lit from scratch
+	void testGeneratedChunk(LightModel model)
+	{
+		const int CHUNKS = 3;
+		const int SIZE   = 16;
+
+		LightEngine engine(model);
+
+		World scratch(model, CHUNKS, SIZE);
+		generateFloor(scratch);
+		generateRoof(*scratch.getChunk(1, CHUNKS - 1, 1));
+
+		scratch.lightSky(engine);
+		scratch.update(engine);
+
+		World world(model, CHUNKS, SIZE);
+		generateFloor(world);
+
+		world.lightSky(engine);
+		world.update(engine);
+
+		Chunk* chunk = world.replaceChunk(1, CHUNKS - 1, 1);
+		generateRoof(*chunk);
+
+		int x, y, z;
+		for (x = 0; x < SIZE; ++x)
+		{
+			for (z = 0; z < SIZE; ++z)
+			{
+				int gx = SIZE + x;
+				int gz = SIZE + z;
+
+				// the top block of the column is the top of the chunk, everything below it down to the floor
+				// loses its light from above
+				for (y = CHUNKS * SIZE - 1; y >= FLOOR; --y)
+					engine.removeSkyLight(*world.getBlockChunk(gx, y, gz), gx % SIZE, y % SIZE, gz % SIZE);
+			}
+		}
+
+		// then the light of the neighbors flows in through the border blocks
+		for (x = 0; x < SIZE; ++x)
+		{
+			for (y = 0; y < SIZE; ++y)
+			{
+				for (z = 0; z < SIZE; ++z)
+				{
+					if (x == 0 || y == 0 || z == 0 || x == SIZE - 1 || y == SIZE - 1 || z == SIZE - 1)
+						chunk->getPendingLights().push_back(chunk->getIndex(x, y, z));
+				}
+			}
+		}
+
+		world.update(engine);
+
+		check("generated chunk closes lit columns", model, world, scratch);
+	}
+
+	// solid rock with winding tunnels where three waves along the axes meet, about a fifth of the blocks are air
+	void generateCaves(World& world)
+	{
+		int extent = world.chunks * world.size;
+
+		int x, y, z;
+		for (x = 0; x < extent; ++x)
+		{
+			for (y = 0; y < extent; ++y)
+			{
+				for (z = 0; z < extent; ++z)
+				{
+					if (std::sin(x * 0.3f) + std::sin(y * 0.4f) + std::sin(z * 0.35f) < 1.0f)
+						world.setBlock(x, y, z, 3);
+				}
+			}
+		}
+	}
+
+	struct TorchFill
+	{
+		double seconds;
+		unsigned int bytes; // block and light data of every chunk after the fill
+	};
+
+	// time placing torches through a cave system in one fill, the rate is nodes taken off the queue per second
+	TorchFill testTorches(LightModel model)
+	{
+		const int CHUNKS  = 4;
+		const int SIZE    = 16;
+		const int TORCHES = 64;
+
+		World world(model, CHUNKS, SIZE);
+		generateCaves(world);
+
+		// torches go on air blocks only
+		std::vector<Source> torches;
+		std::vector<Source> candidates = generateSources(TORCHES * 8, CHUNKS * SIZE, 23);
+
+		for (const Source& candidate : candidates)
+		{
+			if (torches.size() == TORCHES) break;
+
+			Chunk* chunk = world.getBlockChunk(candidate.x, candidate.y, candidate.z);
+
+			if (chunk->getBlock(candidate.x % SIZE, candidate.y % SIZE, candidate.z % SIZE).t != 0) continue;
+
+			Source torch = candidate;
+			torch.r = 15;
+			torch.g = 12;
+			torch.b = 8;
+
+			torches.push_back(torch);
+		}
+
+		LightEngine engine(model);
+
+		for (const Source& torch : torches)
+			world.addSource(torch);
+
+		engine.resetStats();
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		world.update(engine);
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		unsigned int nodes = engine.getNodesProcessed();
+
+		TorchFill fill = { seconds, 0 };
+
+		for (Chunk* chunk : world.grid)
+			fill.bytes += chunk->getMemoryUsage();
+
+		// every torch lights at least its own block
+		bool ok = (torches.size() == TORCHES && nodes >= TORCHES);
+
+		printf("%-48s %-9s %s", "place torches in caves", (model == LightModel::PER_VOXEL) ? "per voxel" : "per face", ok ? "ok" : "FAILED");
+		printf(", %u nodes in %.2f ms, %.1f million nodes/s\n", nodes, seconds * 1000, nodes / seconds / 1e6);
+
+		if (!ok)
+			++failures;
+
+		return fill;
+	}
+
+	// the same torches lit with each model, the time is only printed as it depends on the machine
+	void compareModels(const TorchFill& perFace, const TorchFill& perVoxel)
+	{
+		bool ok = perVoxel.bytes < perFace.bytes;
+
+		printf("%-48s %-9s %s", "light model memory and fill time", "", ok ? "ok" : "FAILED");
+		printf(", per voxel %u KB in %.2f ms, per face %u KB in %.2f ms\n", perVoxel.bytes / 1024, perVoxel.seconds * 1000,
+			perFace.bytes / 1024, perFace.seconds * 1000);
+
+		if (!ok)
+			++failures;
+	}
+}
+
+int main()
+{
+	LightModel models[] = { LightModel::PER_FACE, LightModel::PER_VOXEL };
+
+	TorchFill fills[2];
+
+	int i;
+	for (i = 0; i < 2; ++i)
+	{
+		testSources(models[i]);
+		testRemoval(models[i]);
+		testDigging(models[i]);
+		testParallel(models[i]);
+		testGeneratedChunk(models[i]);
+		fills[i] = testTorches(models[i]);
+	}
+
+	compareModels(fills[0], fills[1]);
+
+	return failures == 0 ? 0 : 1;
+}
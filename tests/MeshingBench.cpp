@@ -0,0 +1,302 @@
+
+/**
+	Measures how long single chunks take to mesh and how many chunks per second the meshing threads build.
+
+	A chunk of mixed solid blocks with scattered air, a chunk of solid stone and a cave chunk lit per voxel by
+	the sky and a torch, each surrounded by chunks like it, are meshed in both modes on the calling thread. The
+	lit chunk shows the cost of averaging the light around each face corner. Then a fixed terrain of rolling hills with caves
+	is meshed from scratch with 1, 2 and 4 threads and with one thread per hardware thread, the way
+	ChunkManager::rebuildChunks does. Snapshots are taken on the main thread before the timing starts, only
+	the mesh generation is timed. Links against Chunk, BlockStorage, ChunkMesh, TileRegionBuffer,
+	QuadIndexBuffer, LightEngine and ThreadPool, no GL context is needed as the meshes are never uploaded.
+	Prints the single chunk times and the rate of every thread count
+*/
+
+#include "Chunk.h"
+#include "ThreadPool.h"
+
+#include <SGL/Math/Vector4.h>
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+
+using namespace engine;
+using namespace sgl;
+
+namespace
+{
+	const int SIZE   = 16;  // blocks per chunk axis, the engine default
+	const int GRID_X = 16;
+	const int GRID_Y = 4;
+	const int GRID_Z = 16;
+	const int PASSES = 3;
+
+	// grass over dirt over stone, with caves below the surface
+	int getTerrain(int x, int y, int z)
+	{
+		float height = 32 + 12 * std::sin(x * 0.05f) * std::cos(z * 0.07f) + 6 * std::sin((x + z) * 0.13f);
+
+		if (y > height) return 0;
+
+		if (std::sin(x * 0.2f) * std::sin(y * 0.3f) * std::sin(z * 0.25f) > 0.4f) return 0;
+
+		if (y + 1 > height) return 1;
+		if (y + 4 > height) return 2;
+
+		return 3;
+	}
+
+	struct World
+	{
+		std::vector<Chunk*> grid;
+		std::vector<Vector4> regions;
+
+		World() :
+			regions(3, Vector4(0, 0, 1, 1))
+		{
+			int x, y, z;
+			for (x = 0; x < GRID_X; ++x)
+			{
+				for (y = 0; y < GRID_Y; ++y)
+				{
+					for (z = 0; z < GRID_Z; ++z)
+					{
+						Chunk* chunk = new Chunk(SIZE);
+						chunk->setLocation(x, y, z);
+						chunk->setTileRegions(&regions);
+
+						grid.push_back(chunk);
+					}
+				}
+			}
+
+			for (x = 0; x < GRID_X; ++x)
+			{
+				for (y = 0; y < GRID_Y; ++y)
+				{
+					for (z = 0; z < GRID_Z; ++z)
+					{
+						Chunk* chunk = getChunk(x, y, z);
+
+						chunk->left   = getChunk(x - 1, y, z);
+						chunk->right  = getChunk(x + 1, y, z);
+						chunk->top    = getChunk(x, y + 1, z);
+						chunk->bottom = getChunk(x, y - 1, z);
+						chunk->near   = getChunk(x, y, z - 1);
+						chunk->far    = getChunk(x, y, z + 1);
+
+						fill(chunk, x, y, z);
+					}
+				}
+			}
+		}
+
+		~World()
+		{
+			for (Chunk* chunk : grid)
+				delete chunk;
+		}
+
+		Chunk* getChunk(int x, int y, int z)
+		{
+			if (x < 0 || y < 0 || z < 0 || x >= GRID_X || y >= GRID_Y || z >= GRID_Z) return nullptr;
+
+			return grid[(x * GRID_Y + y) * GRID_Z + z];
+		}
+
+		void fill(Chunk* chunk, int cx, int cy, int cz)
+		{
+			int x, y, z;
+			for (x = 0; x < SIZE; ++x)
+			{
+				for (y = 0; y < SIZE; ++y)
+				{
+					for (z = 0; z < SIZE; ++z)
+						chunk->setBlock(x, y, z, getTerrain(cx * SIZE + x, cy * SIZE + y, cz * SIZE + z));
+				}
+			}
+		}
+	};
+
+	// mixed solid blocks with an air block in eight
+	int getDenseType(int x, int y, int z)
+	{
+		return ((x * 7 + y * 13 + z * 5) % 8 == 0) ? 0 : 1 + (x * 3 + y * 5 + z * 7) % 3;
+	}
+
+	// stone throughout, with its neighbors there are no faces to mesh so culling is most of the work
+	int getSolidType(int x, int y, int z)
+	{
+		return 3;
+	}
+
+	// winding tunnels through stone
+	int getCaveType(int x, int y, int z)
+	{
+		return (std::sin(x * 0.5f) + std::sin(y * 0.6f) + std::sin(z * 0.45f) > 0.6f) ? 0 : 3;
+	}
+
+	// sky light fading with depth and a red torch in the middle of the chunk, so no two neighboring cells have
+	// quite the same light
+	light_t getCaveLight(int x, int y, int z)
+	{
+		int torch = MAX_LIGHT_LEVEL - 1 - (std::abs(x - SIZE / 2) + std::abs(y - SIZE / 2) + std::abs(z - SIZE / 2));
+
+		light_t light = 0;
+		SET_LIGHT_LEVEL_S(light, std::max(y - 1, 0));
+		SET_LIGHT_LEVEL_R(light, std::max(torch, 0));
+
+		return light;
+	}
+
+	// microseconds to mesh a chunk whose six neighbors are filled the same way, on the calling thread, best
+	// of the passes. The air is lit per voxel by getLight when there is one
+	double meshChunk(Chunk::MeshMode mode, int (*getType)(int, int, int), light_t (*getLight)(int, int, int) = nullptr)
+	{
+		const int REPEATS = 200;
+
+		std::vector<Vector4> regions(3, Vector4(0, 0, 1, 1));
+
+		Chunk chunk(SIZE);
+		chunk.setTileRegions(&regions);
+
+		Chunk left(SIZE), right(SIZE), top(SIZE), bottom(SIZE), near(SIZE), far(SIZE);
+
+		chunk.left   = &left;
+		chunk.right  = &right;
+		chunk.top    = &top;
+		chunk.bottom = &bottom;
+		chunk.near   = &near;
+		chunk.far    = &far;
+
+		Chunk* chunks[] = { &chunk, &left, &right, &top, &bottom, &near, &far };
+
+		for (Chunk* filled : chunks)
+		{
+			if (getLight)
+				filled->setLightModel(LightModel::PER_VOXEL);
+
+			int x, y, z;
+			for (x = 0; x < SIZE; ++x)
+			{
+				for (y = 0; y < SIZE; ++y)
+				{
+					for (z = 0; z < SIZE; ++z)
+					{
+						int type = getType(x, y, z);
+
+						filled->setBlock(x, y, z, type);
+
+						if (getLight && type == 0)
+							filled->setLight(filled->getIndex(x, y, z), BlockFace::LEFT, getLight(x, y, z));
+					}
+				}
+			}
+		}
+
+		double best = 1e9;
+
+		int pass, i;
+		for (pass = 0; pass < PASSES; ++pass)
+		{
+			double total = 0;
+
+			for (i = 0; i < REPEATS; ++i)
+			{
+				chunk.setMeshMode(mode);
+				chunk.takeSnapshot();
+
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+				chunk.generateMesh();
+
+				total += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+			}
+
+			best = std::min(best, total / REPEATS);
+		}
+
+		return best;
+	}
+
+	// seconds to mesh every chunk of the world once, on the calling thread alone when there is no pool
+	double meshWorld(World& world, util::ThreadPool* pool)
+	{
+		for (Chunk* chunk : world.grid)
+		{
+			// remesh the whole chunk rather than the sections edited since the last pass
+			chunk->setMeshMode(Chunk::MeshMode::CUBE);
+			chunk->takeSnapshot();
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		if (pool)
+		{
+			for (Chunk* chunk : world.grid)
+				pool->submit([chunk]{ chunk->generateMesh(); });
+
+			pool->wait();
+		}
+		else
+		{
+			for (Chunk* chunk : world.grid)
+				chunk->generateMesh();
+		}
+
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main()
+{
+	printf("dense chunk %8.1f us cube, %8.1f us greedy\n", meshChunk(Chunk::MeshMode::CUBE, getDenseType), meshChunk(Chunk::MeshMode::GREEDY, getDenseType));
+	printf("solid chunk %8.1f us cube, %8.1f us greedy\n", meshChunk(Chunk::MeshMode::CUBE, getSolidType), meshChunk(Chunk::MeshMode::GREEDY, getSolidType));
+	printf("lit chunk   %8.1f us cube, %8.1f us greedy\n", meshChunk(Chunk::MeshMode::CUBE, getCaveType, getCaveLight), meshChunk(Chunk::MeshMode::GREEDY, getCaveType, getCaveLight));
+
+	World world;
+
+	std::vector<unsigned int> threadCounts = { 1, 2, 4 };
+
+	unsigned int hardware = std::thread::hardware_concurrency();
+
+	if (hardware > 4)
+		threadCounts.push_back(hardware);
+
+	printf("meshing %d chunks of %d blocks, best of %d passes\n", (int)world.grid.size(), SIZE, PASSES);
+
+	double single = 0;
+
+	for (unsigned int threads : threadCounts)
+	{
+		// the calling thread meshes while it waits on the pool, so it is one of the threads
+		std::unique_ptr<util::ThreadPool> pool;
+
+		if (threads > 1)
+			pool.reset(new util::ThreadPool(threads - 1));
+
+		// the first pass also sizes the vertex buffers
+		meshWorld(world, pool.get());
+
+		double best = 1e9;
+
+		int pass;
+		for (pass = 0; pass < PASSES; ++pass)
+			best = std::min(best, meshWorld(world, pool.get()));
+
+		double rate = world.grid.size() / best;
+
+		if (threads == 1)
+			single = rate;
+
+		printf("%2u threads %10.0f chunks/s %6.2fx\n", threads, rate, rate / single);
+	}
+
+	return 0;
+}
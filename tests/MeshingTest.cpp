@@ -0,0 +1,140 @@
+
+/**
+	Checks the number of quads the cube and greedy meshers make for fixed chunks.
+
+	A solid chunk, a checkerboard of solid and air blocks and a slab of two block types are meshed alone, so
+	the faces on the chunk sides are exposed. The cube mesher makes a quad per exposed face. The greedy
+	mesher merges them into one quad per side of the solid chunk, can merge nothing in the checkerboard and
+	makes one quad per side and block type of the slab. Then a wall across a chunk is opened and closed
+	again, remeshing the edited blocks only, and the sides it splits have to be joined only while it is open.
+	Links against Chunk, BlockStorage, ChunkMesh, TileRegionBuffer, QuadIndexBuffer and LightEngine, no GL
+	context is needed as the meshes are never uploaded. Returns non zero when a check fails
+*/
+
+#include "Chunk.h"
+
+#include <SGL/Math/Vector4.h>
+
+#include <vector>
+#include <functional>
+#include <cstdio>
+
+using namespace engine;
+using namespace sgl;
+
+namespace
+{
+	const int SIZE = 16;  // blocks per chunk axis
+
+	int failures = 0;
+
+	unsigned int countQuads(Chunk::MeshMode mode, const std::function<int(int, int, int)>& getType)
+	{
+		std::vector<Vector4> regions(2, Vector4(0, 0, 1, 1));
+
+		Chunk chunk(SIZE);
+		chunk.setTileRegions(&regions);
+		chunk.setMeshMode(mode);
+
+		int x, y, z;
+		for (x = 0; x < SIZE; ++x)
+		{
+			for (y = 0; y < SIZE; ++y)
+			{
+				for (z = 0; z < SIZE; ++z)
+					chunk.setBlock(x, y, z, getType(x, y, z));
+			}
+		}
+
+		chunk.takeSnapshot();
+		chunk.generateMesh();
+
+		return chunk.getGeneratedVertexCount() / 4;
+	}
+
+	void check(const char* name, const std::function<int(int, int, int)>& getType, unsigned int cubeQuads, unsigned int greedyQuads)
+	{
+		unsigned int cube   = countQuads(Chunk::MeshMode::CUBE, getType);
+		unsigned int greedy = countQuads(Chunk::MeshMode::GREEDY, getType);
+
+		bool ok = (cube == cubeQuads && greedy == greedyQuads);
+
+		printf("%-48s %s", name, ok ? "ok" : "FAILED");
+		printf(", %u cube quads, %u greedy quads\n", cube, greedy);
+
+		if (!ok)
+			++failures;
+	}
+
+	// a wall of stone across x splits the left side of the chunk from the right, a hole joins them
+	void testSideConnections()
+	{
+		std::vector<Vector4> regions(2, Vector4(0, 0, 1, 1));
+
+		Chunk chunk(SIZE);
+		chunk.setTileRegions(&regions);
+		chunk.setCaveCulling(true);
+
+		int y, z;
+		for (y = 0; y < SIZE; ++y)
+		{
+			for (z = 0; z < SIZE; ++z)
+				chunk.setBlock(SIZE / 2, y, z, 1);
+		}
+
+		chunk.takeSnapshot();
+		chunk.generateMesh();
+
+		bool closed = !chunk.areSidesConnected(BlockFace::LEFT, BlockFace::RIGHT) && chunk.areSidesConnected(BlockFace::TOP, BlockFace::BOTTOM);
+
+		chunk.setBlock(SIZE / 2, 3, 5, 0);
+		chunk.takeSnapshot();
+		chunk.generateMesh();
+
+		bool opened = chunk.areSidesConnected(BlockFace::LEFT, BlockFace::RIGHT);
+
+		// changing the type of a wall block keeps the air as it was
+		chunk.setBlock(SIZE / 2, 3, 5, 1);
+		chunk.setBlock(SIZE / 2, 7, 7, 2);
+		chunk.takeSnapshot();
+		chunk.generateMesh();
+
+		bool reclosed = !chunk.areSidesConnected(BlockFace::LEFT, BlockFace::RIGHT);
+
+		bool ok = closed && opened && reclosed;
+
+		printf("%-48s %s", "side connections follow edits", ok ? "ok\n" : "FAILED");
+
+		if (!ok)
+		{
+			printf(", wall %s, hole %s, wall again %s\n", closed ? "ok" : "wrong", opened ? "ok" : "wrong", reclosed ? "ok" : "wrong");
+			++failures;
+		}
+	}
+}
+
+int main()
+{
+	check("solid chunk", [](int x, int y, int z)
+	{
+		return 1;
+	}, 6 * SIZE * SIZE, 6);
+
+	// every solid block shows all its faces, and no two faces in a plane touch
+	check("checkerboard", [](int x, int y, int z)
+	{
+		return ((x + y + z) & 1) == 0 ? 1 : 0;
+	}, 3 * SIZE * SIZE * SIZE, 3 * SIZE * SIZE * SIZE);
+
+	// one layer, two halves of different types
+	check("mixed type slab", [](int x, int y, int z)
+	{
+		if (y > 0) return 0;
+
+		return (x < SIZE / 2) ? 1 : 2;
+	}, 2 * SIZE * SIZE + 4 * SIZE, 10);
+
+	testSideConnections();
+
+	return failures == 0 ? 0 : 1;
+}
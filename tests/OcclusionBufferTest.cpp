@@ -0,0 +1,311 @@
+
+/**
+	Checks that the occlusion buffer is conservative, a box reported occluded must not be visible anywhere.
+
+	A camera moves along a path in front of a wall made of tiles with gaps narrower than a pixel, next to a
+	solid wall. Every frame the walls are drawn into the buffer, and each box behind them that the buffer
+	reports occluded is tested against rays from the eye through the gaps and over the whole view. A ray
+	that reaches the box without hitting the walls means the box was culled while visible. Also prints the
+	share of the boxes in view that were culled and the time drawing and testing take per frame. Links against
+	OcclusionBuffer and ViewFrustum. Returns non zero when a check fails
+*/
+
+#include "OcclusionBuffer.h"
+
+#include <SGL/Math/Vector3.h>
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+using namespace engine;
+using namespace sgl;
+
+namespace
+{
+	const int WIDTH  = 128;
+	const int HEIGHT = 64;
+
+	const float FOV   = 70.0f;
+	const float RATIO = 2.0f;
+
+	// walls lie in the plane z = WALL_Z facing the camera, tiles are TILE wide with GAP between them
+	const float WALL_Z = 20.0f;
+	const float TILE   = 1.0f;
+	const float GAP    = 0.04f;
+	const int   TILES  = 16;
+
+	// tiled wall from TILED_MIN on both axes, solid wall to its right
+	const float TILED_MIN = -TILES * (TILE + GAP) * 0.5f;
+	const float TILED_MAX = TILED_MIN + TILES * (TILE + GAP);
+	const float SOLID_MAX = TILED_MAX + 24.0f;
+
+	struct Box
+	{
+		Vector3 min;
+		Vector3 max;
+	};
+
+	struct Camera
+	{
+		Vector3 position;
+		Vector3 direction;
+		Vector3 right;
+		Vector3 up;
+		ViewFrustum frustum;
+	};
+
+	int failures = 0;
+
+	Camera makeCamera(const Vector3& position, const Vector3& target)
+	{
+		Camera camera;
+		camera.position  = position;
+		camera.direction = target - position;
+		camera.direction.normalize();
+
+		camera.right.set(camera.direction).cross(Vector3(0, 1, 0));
+		camera.right.normalize();
+
+		camera.up.set(camera.right).cross(camera.direction);
+		camera.up.normalize();
+
+		camera.frustum.construct(FOV, RATIO, 0.1f, 200.0f, camera.position, camera.direction, camera.right, camera.up);
+
+		return camera;
+	}
+
+	// true if the point on the wall plane is covered by a tile or the solid wall
+	bool isWall(float x, float y)
+	{
+		if (y < TILED_MIN || y > TILED_MAX || x < TILED_MIN || x > SOLID_MAX) return false;
+
+		if (x > TILED_MAX) return true;
+
+		float tx = std::fmod(x - TILED_MIN, TILE + GAP);
+		float ty = std::fmod(y - TILED_MIN, TILE + GAP);
+
+		return tx <= TILE && ty <= TILE;
+	}
+
+	void drawWalls(OcclusionBuffer& buffer)
+	{
+		Vector3 corners[4];
+
+		int x, y;
+		for (x = 0; x < TILES; ++x)
+		{
+			for (y = 0; y < TILES; ++y)
+			{
+				float x0 = TILED_MIN + x * (TILE + GAP);
+				float y0 = TILED_MIN + y * (TILE + GAP);
+
+				corners[0] = Vector3(x0, y0, WALL_Z);
+				corners[1] = Vector3(x0 + TILE, y0, WALL_Z);
+				corners[2] = Vector3(x0 + TILE, y0 + TILE, WALL_Z);
+				corners[3] = Vector3(x0, y0 + TILE, WALL_Z);
+
+				buffer.drawQuad(corners);
+			}
+		}
+
+		corners[0] = Vector3(TILED_MAX, TILED_MIN, WALL_Z);
+		corners[1] = Vector3(SOLID_MAX, TILED_MIN, WALL_Z);
+		corners[2] = Vector3(SOLID_MAX, TILED_MAX, WALL_Z);
+		corners[3] = Vector3(TILED_MAX, TILED_MAX, WALL_Z);
+
+		buffer.drawQuad(corners);
+	}
+
+	// true if the ray from the camera through point p is inside the view and reaches box past the walls
+	bool seesBox(const Camera& camera, const Vector3& p, const Box& box)
+	{
+		float sx, sy, depth;
+
+		if (!camera.frustum.project(p, sx, sy, depth)) return false;
+		if (std::fabs(sx) > 1 || std::fabs(sy) > 1) return false;
+
+		Vector3 d = p - camera.position;
+
+		// slab test for where the ray enters and leaves the box
+		float t0 = 0, t1 = 1e9f;
+
+		const float* o  = &camera.position.x;
+		const float* dv = &d.x;
+		const float* b0 = &box.min.x;
+		const float* b1 = &box.max.x;
+
+		int i;
+		for (i = 0; i < 3; ++i)
+		{
+			if (dv[i] == 0)
+			{
+				if (o[i] < b0[i] || o[i] > b1[i]) return false;
+				continue;
+			}
+
+			float ta = (b0[i] - o[i]) / dv[i];
+			float tb = (b1[i] - o[i]) / dv[i];
+
+			t0 = std::max(t0, std::min(ta, tb));
+			t1 = std::min(t1, std::max(ta, tb));
+		}
+
+		if (t0 > t1) return false;
+
+		// the walls block the ray when it crosses them before leaving the box
+		if (d.z != 0)
+		{
+			float t = (WALL_Z - camera.position.z) / d.z;
+
+			if (t > 0 && t <= t1 && isWall(camera.position.x + d.x * t, camera.position.y + d.y * t)) return false;
+		}
+
+		return true;
+	}
+
+	bool isVisible(const Camera& camera, const Box& box)
+	{
+		// rays through the middle of every gap, where a rasterizer sampling pixel centers leaks
+		float step = GAP * 0.5f;
+		float s;
+
+		int i;
+		for (i = 1; i < TILES; ++i)
+		{
+			float gap = TILED_MIN + i * (TILE + GAP) - GAP * 0.5f;
+
+			for (s = TILED_MIN; s <= TILED_MAX; s += step)
+			{
+				if (seesBox(camera, Vector3(gap, s, WALL_Z), box)) return true;
+				if (seesBox(camera, Vector3(s, gap, WALL_Z), box)) return true;
+			}
+		}
+
+		// rays over the whole view at four per pixel, for the edges of the walls
+		int x, y;
+		for (y = 0; y < HEIGHT * 2; ++y)
+		{
+			for (x = 0; x < WIDTH * 2; ++x)
+			{
+				float sx = (x + 0.5f) / WIDTH - 1;
+				float sy = (y + 0.5f) / HEIGHT - 1;
+
+				float tanV = std::tan(FOV * 0.5f * 3.14159265f / 180.0f);
+				float tanH = tanV * RATIO;
+
+				Vector3 p = camera.position + camera.direction + camera.right * (sx * tanH) + camera.up * (sy * tanV);
+
+				if (seesBox(camera, p, box)) return true;
+			}
+		}
+
+		return false;
+	}
+
+	void testCameraPath()
+	{
+		std::vector<Box> boxes;
+
+		float x, y, z;
+		for (x = -16; x < 40; x += 3)
+		{
+			for (y = -10; y < 10; y += 3)
+			{
+				for (z = 24; z < 40; z += 5)
+				{
+					Box box;
+					box.min = Vector3(x, y, z);
+					box.max = Vector3(x + 2, y + 2, z + 2);
+
+					boxes.push_back(box);
+				}
+			}
+		}
+
+		OcclusionBuffer buffer(WIDTH, HEIGHT);
+
+		const int FRAMES = 24;
+
+		unsigned int occluded = 0;
+		unsigned int leaks    = 0;
+		unsigned int inView   = 0;
+
+		// time spent drawing the walls and testing the boxes, without the ray checks
+		double drawTime = 0;
+		double testTime = 0;
+
+		std::vector<const Box*> hidden;
+
+		int frame;
+		for (frame = 0; frame < FRAMES; ++frame)
+		{
+			float f = (float)frame / (FRAMES - 1);
+
+			Vector3 position(-6 + 20 * f, -2 + 4 * f, -4 + 6 * f);
+			Vector3 target(4 + 10 * std::sin(f * 6.0f), 2 * std::cos(f * 5.0f), 30);
+
+			Camera camera = makeCamera(position, target);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			buffer.clear(camera.frustum);
+			drawWalls(buffer);
+
+			std::chrono::steady_clock::time_point drawn = std::chrono::steady_clock::now();
+
+			// only boxes in the view are tested, as the chunk manager tests the chunks the frustum accepts
+			hidden.clear();
+
+			for (const Box& box : boxes)
+			{
+				if (camera.frustum.checkBox(box.min, box.max) == ViewFrustum::Side::OUTSIDE) continue;
+
+				++inView;
+
+				if (buffer.isOccluded(box.min, box.max))
+					hidden.push_back(&box);
+			}
+
+			std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+			drawTime += std::chrono::duration<double, std::milli>(drawn - start).count();
+			testTime += std::chrono::duration<double, std::milli>(end - drawn).count();
+
+			occluded += (unsigned int)hidden.size();
+
+			for (const Box* box : hidden)
+			{
+				if (isVisible(camera, *box))
+					++leaks;
+			}
+		}
+
+		printf("%-48s %s", "occluded boxes are hidden along a camera path", leaks == 0 ? "ok\n" : "FAILED");
+
+		if (leaks != 0)
+		{
+			printf(", %u of %u occluded boxes are visible\n", leaks, occluded);
+			++failures;
+		}
+
+		// the solid wall has to hide something, or the check above proves nothing
+		printf("%-48s %s", "the solid wall occludes boxes", occluded != 0 ? "ok\n" : "FAILED\n");
+
+		if (occluded == 0)
+			++failures;
+
+		printf("%-48s %.1f%% culled of %u boxes in view per frame, %.3f ms drawing and %.3f ms testing a frame\n",
+			"occlusion culling rate and cost", inView != 0 ? 100.0f * occluded / inView : 0.0f, inView / FRAMES,
+			drawTime / FRAMES, testTime / FRAMES);
+	}
+}
+
+int main()
+{
+	testCameraPath();
+
+	return failures == 0 ? 0 : 1;
+}